@@ -0,0 +1,76 @@
+#ifndef ACTOR_H
+#define ACTOR_H
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "mpsc_queue.h"
+#include "serial_executor.h"
+#include "threadpool.h"
+
+//一次激活最多处理的消息数，处理完还有消息就重新排到线程池队尾，别的actor也能轮到
+const int ACTOR_THROUGHPUT = 32;
+
+//跑在线程池上的actor：一个MPSC邮箱 + 一个处理消息的behavior
+//邮箱为空的actor不占线程，也不在线程池的队列里，只占自己这点内存，所以可以有几百万个；
+//调度和Strand一样由SerialExecutor负责：tell()让邮箱从空变成非空的那个发送者负责把actor投进线程池(激活)，
+//同一时刻最多一个激活在排队或执行，behavior不会被并发调用，actor自己的状态不需要加锁
+//pending()是邮箱里还没处理的消息数
+//Msg要能默认构造(MpscQueue的要求)。必须由shared_ptr持有(用spawnActor创建)，生命周期不能超过线程池
+template<typename Msg>
+class Actor : public SerialExecutor
+{
+public:
+    using Behavior = std::function<void(Msg&)>;
+
+    Actor(ThreadPool& pool, Behavior behavior, int throughput = ACTOR_THROUGHPUT)
+        : SerialExecutor(pool, throughput)
+        , behavior_(std::move(behavior))
+        , dropped_(0)
+        , failed_(0)
+    {}
+
+    //发消息，不等处理。线程池已经shutdown或者队列满时，在发送线程里直接处理
+    void tell(Msg msg)
+    {
+        mailbox_.push(std::move(msg));
+        post();
+    }
+    //激活被取消(shutdown(CANCEL_PENDING)、DROP_OLDEST)时丢掉的消息数
+    uint64_t getDropped() const { return dropped_.load(std::memory_order_relaxed); }
+    //behavior抛了异常的消息数，这条消息算处理完，接着处理下一条
+    uint64_t getFailed() const { return failed_.load(std::memory_order_relaxed); }
+private:
+    void processOne()
+    {
+        Msg msg = popPending(mailbox_);
+        //异常不能漏到SerialExecutor里，否则跳过pending计数，这个actor再也不会被激活
+        try
+        {
+            behavior_(msg);
+        }
+        catch (...)
+        {
+            failed_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void discardOne()
+    {
+        popPending(mailbox_);
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Behavior behavior_;
+    MpscQueue<Msg, false> mailbox_; //不按缓存行对齐，一个空闲actor少占一百多字节
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> failed_;
+};
+
+template<typename Msg>
+std::shared_ptr<Actor<Msg>> spawnActor(ThreadPool& pool, typename Actor<Msg>::Behavior behavior,
+    int throughput = ACTOR_THROUGHPUT)
+{
+    return std::make_shared<Actor<Msg>>(pool, std::move(behavior), throughput);
+}
+
+#endif //ACTOR_H
@@ -0,0 +1,42 @@
+#ifndef BENCH_LATCH_H
+#define BENCH_LATCH_H
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+//benchmark里等count个任务完成，Latch一般放在栈上，wait()返回后马上析构
+//前面的countDown只做一次无锁的CAS，不碰锁；最后一个持锁把计数减到0再通知：
+//等待者只能在锁里看到0，它能返回的时候通知者已经不会再访问这个对象了
+//(原来先fetch_sub到0再拿锁通知，等待者可能已经看到0返回、把Latch析构了，通知者再去拿一把已经销毁的锁)
+class Latch
+{
+public:
+    explicit Latch(long long count) : count_(count) {}
+    Latch(const Latch&) = delete;
+    Latch& operator=(const Latch&) = delete;
+    void countDown()
+    {
+        long long count = count_.load(std::memory_order_relaxed);
+        while (count > 1)
+        {
+            if (count_.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            {
+                return;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mtx_);
+        count_.fetch_sub(1, std::memory_order_acq_rel);
+        cond_.notify_all();
+    }
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cond_.wait(lock, [this]() { return count_.load(std::memory_order_acquire) == 0; });
+    }
+private:
+    std::atomic<long long> count_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+};
+
+#endif //BENCH_LATCH_H
@@ -0,0 +1,30 @@
+#ifndef BENCH_POOL_H
+#define BENCH_POOL_H
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+//bench用的统一接口：仓库里四个线程池的提交方式都不一样，每个包一层适配器，
+//每个适配器放在单独的.cpp里(几个线程池的类名、Thread类都重名，不能出现在同一个编译单元)
+class BenchPool
+{
+public:
+    virtual ~BenchPool() = default;
+    virtual const char* name() const = 0;
+    //提交一个任务，不关心返回值
+    virtual void submit(std::function<void()> task) = 0;
+};
+
+using BenchPoolFactory = std::unique_ptr<BenchPool> (*)(int threads);
+
+//src/threadpool.cpp里的ThreadPool(fixed模式)
+std::unique_ptr<BenchPool> makeTaskThreadPool(int threads);
+//ThreadPool_change/include/threadpool.h里可变参submitTask的ThreadPool(fixed模式)
+std::unique_ptr<BenchPool> makeVariadicThreadPool(int threads);
+//threadpool_r3.hpp里的Common_tools::ThreadPool
+std::unique_ptr<BenchPool> makeR3ThreadPool(int threads);
+//thread.h里的SEACAVE::ThreadPool，它只负责起线程，任务队列是适配器自己加的
+std::unique_ptr<BenchPool> makeSeacaveThreadPool(int threads);
+
+#endif //BENCH_POOL_H
@@ -0,0 +1,38 @@
+#ifndef CANCELLATION_H
+#define CANCELLATION_H
+#include <atomic>
+#include <memory>
+
+//协作式取消：用户持有CancellationSource，把它的token随任务一起提交
+//request_stop()之后：还在队列里的任务出队时直接跳过，Result::isCancelled()为true；
+//已经在执行的任务不会被打断，需要在run里自己检查stop_requested()提前返回
+class CancellationToken
+{
+public:
+    //默认构造的token永远不会被取消
+    CancellationToken() = default;
+    bool stop_requested() const
+    {
+        return state_ != nullptr && state_->load(std::memory_order_acquire);
+    }
+    //有没有关联CancellationSource
+    bool stop_possible() const { return state_ != nullptr; }
+private:
+    friend class CancellationSource;
+    explicit CancellationToken(std::shared_ptr<std::atomic_bool> state) : state_(std::move(state)) {}
+    std::shared_ptr<std::atomic_bool> state_;
+};
+
+class CancellationSource
+{
+public:
+    CancellationSource() : state_(std::make_shared<std::atomic_bool>(false)) {}
+    //取消所有拿了这个source的token的任务，可以重复调用
+    void request_stop() { state_->store(true, std::memory_order_release); }
+    bool stop_requested() const { return state_->load(std::memory_order_acquire); }
+    CancellationToken token() const { return CancellationToken(state_); }
+private:
+    std::shared_ptr<std::atomic_bool> state_;
+};
+
+#endif //CANCELLATION_H
@@ -0,0 +1,18 @@
+#ifndef CPU_QUOTA_H
+#define CPU_QUOTA_H
+
+//容器CPU配额探测
+//k8s pod里hardware_concurrency()返回的是宿主机的核数，按它开线程会被CFS限流(throttling)
+//这里综合cgroup v1/v2的CPU配额和线程亲和性掩码，算出真正能用的CPU数
+class CpuQuota
+{
+public:
+    //cgroup限制的CPU数(quota / period)，可能是小数，如1.5；没有限制返回0
+    static double cgroupCpuLimit();
+    //当前线程亲和性掩码(sched_getaffinity)里的CPU个数，取不到时退回hardware_concurrency()
+    static int affinityCpuCount();
+    //实际可用的CPU数 = min(亲和性CPU数, floor(cgroup配额))，至少为1
+    static int effectiveCpuCount();
+};
+
+#endif //CPU_QUOTA_H
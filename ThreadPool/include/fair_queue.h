@@ -0,0 +1,85 @@
+#ifndef FAIR_QUEUE_H
+#define FAIR_QUEUE_H
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Task;
+
+//每个租户的统计，PoolStats::tenants
+struct TenantStats
+{
+    int id;
+    std::string name;
+    int weight;
+    int queued; //正在排队的任务数
+    uint64_t executed; //执行完的任务数(被取消、丢弃的不算)
+    uint64_t runTime; //这些任务实际执行的总时间(ns)
+};
+
+//多租户的任务队列：每个租户一个FIFO，取任务时按赤字轮转(DRR, deficit round robin)在租户之间分配
+//每个租户轮到时按weight拿到一份时间配额，取一个任务先按这个租户任务的平均执行时间扣配额，
+//执行完再按实际执行时间补差价，所以分到的是CPU时间，不是任务个数：一个租户提交的任务再多、再慢，
+//也只能拿到和它的weight成比例的那一份，其他租户不会被饿死
+//只有一个租户有任务时不用轮转，和原来的单个FIFO一样
+//不是线程安全的，由ThreadPool持有taskQueMtx_时访问
+class FairTaskQueue
+{
+public:
+    static const int DEFAULT_TENANT = 0; //没有指定租户的任务都在这里，权重1
+
+    FairTaskQueue();
+    //注册租户，返回租户id；同名的已经存在就修改权重，返回原来的id
+    int addTenant(const std::string& name, int weight);
+    //租户不存在返回false
+    bool setWeight(int tenant, int weight);
+
+    //tenant不存在就放进DEFAULT_TENANT
+    void push(std::shared_ptr<Task> task, int tenant);
+    //按DRR取下一个任务，tenant返回它属于哪个租户，charged返回预先扣掉的配额，执行完用charge()补差价
+    std::shared_ptr<Task> pop(int& tenant, int64_t& charged);
+    //取所有租户里最早进队列的任务(RejectPolicy::DROP_OLDEST)
+    std::shared_ptr<Task> popOldest();
+    //把还在排队的task拿掉(Result::get()自己执行它)，不在队列里返回false
+    //tenant传入提交时的租户，返回它实际所在的租户(不存在的算DEFAULT_TENANT，和push一样)
+    bool remove(const Task* task, int& tenant);
+    //任务执行完，按实际执行时间actual(ns)修正pop时预扣的charged
+    void charge(int tenant, int64_t charged, int64_t actual);
+    //pop出来的任务没有执行(取消令牌、准入控制丢弃)，把预扣的charged还给租户
+    void refund(int tenant, int64_t charged);
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    std::vector<TenantStats> stats() const;
+private:
+    struct Entry
+    {
+        std::shared_ptr<Task> task;
+        uint64_t seq; //进队列的序号，popOldest用
+    };
+    struct Tenant
+    {
+        std::string name;
+        int weight;
+        int64_t deficit; //剩余配额(ns)，执行超了会是负的，下一轮补
+        int64_t avgCost; //任务平均执行时间(ns)，pop时按它预扣
+        bool visited; //这一轮已经加过配额
+        bool active; //在轮转队列里(有任务在排队)
+        std::deque<Entry> tasks;
+        uint64_t executed;
+        uint64_t runTime;
+    };
+    //所有租户都欠着配额时，把一轮一轮加配额的过程一次算完，不在锁里空转很多圈
+    void catchUp();
+    //队列空了的租户(调用者已经把它移出active_)配额清零，不能攒着等以后一次用掉，欠的还要还
+    void deactivate(int tenant);
+
+    std::vector<Tenant> tenants_; //下标就是租户id，租户不会被删除
+    std::deque<int> active_; //有任务在排队的租户，按轮转顺序
+    size_t size_;
+    uint64_t seq_;
+};
+
+#endif //FAIR_QUEUE_H
@@ -0,0 +1,30 @@
+#ifndef HILL_CLIMBING_H
+#define HILL_CLIMBING_H
+
+//爬山法线程数控制器(思路来自.NET线程池的HillClimbing)
+//每个采样周期比较吞吐量(每秒完成的任务数)：
+//上一次调整让吞吐量涨了，就沿同一方向继续加/减线程，并逐步加大步长；吞吐量降了就反向；
+//变化不明显时倾向于减少线程，因为线程多了只会增加切换和锁竞争
+class HillClimbing
+{
+public:
+    HillClimbing(int minThreads = 1, int maxThreads = 1);
+    //设置线程数的上下限
+    void setBounds(int minThreads, int maxThreads);
+    //输入当前线程数和本周期的吞吐量，返回下一周期的目标线程数
+    int update(int curThreads, double throughput);
+    //丢弃历史样本，比如任务队列空了，吞吐量只取决于提交速度，和线程数无关
+    void reset();
+private:
+    int clamp(int threads) const;
+private:
+    int minThreads_;
+    int maxThreads_;
+    int lastThreads_; //上一个样本的线程数
+    double lastThroughput_; //上一个样本的吞吐量
+    int direction_; //+1加线程，-1减线程
+    int step_; //每次调整的线程数，同方向连续有收益时翻倍
+    bool hasSample_;
+};
+
+#endif //HILL_CLIMBING_H
@@ -0,0 +1,62 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+//HDR风格的延迟直方图：按2的幂分段，每段再线性分成16个桶，相对误差不超过1/16
+//记录的单位是纳秒，最大到2^41ns(约36分钟)，更大的值算在最后一个桶里
+//record只做relaxed的load/store，要求同一个直方图只有一个线程写(每个工作线程一个)，
+//其他线程随时可以读，读到的是某个时刻的近似快照
+class LatencyHistogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAX_EXPONENT = 41;
+    static const int BUCKET_SIZE = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    //单写者记录一个值
+    void record(uint64_t ns)
+    {
+        auto& bucket = buckets_[bucketIndex(ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    //多个线程同时写同一个直方图时用这个
+    void recordConcurrent(uint64_t ns)
+    {
+        buckets_[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+    uint64_t bucketCount(int index) const { return buckets_[index].load(std::memory_order_relaxed); }
+
+    static int bucketIndex(uint64_t ns);
+    //桶里能放的最大值
+    static uint64_t bucketUpperBound(int index);
+private:
+    std::atomic<uint64_t> buckets_[BUCKET_SIZE];
+};
+
+//直方图快照，可以合并多个直方图、求百分位
+class HistogramSnapshot
+{
+public:
+    HistogramSnapshot();
+    void add(const LatencyHistogram& histogram);
+    void add(const HistogramSnapshot& other);
+    //直接记一个值，快照也可以当普通(非线程安全)直方图用
+    void record(uint64_t ns);
+    uint64_t count() const { return count_; }
+    //p取0~100，返回该百分位所在桶的上界(ns)，没有数据返回0
+    uint64_t percentile(double p) const;
+    uint64_t max() const;
+    double mean() const;
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+};
+
+#endif //HISTOGRAM_H
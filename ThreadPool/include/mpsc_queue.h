@@ -0,0 +1,68 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+//多生产者单消费者的无锁队列(Vyukov的链表队列)
+//push：一次exchange把新节点挂到head_上，再把前一个节点的next指过来，任意多个线程可以同时push，不会失败也不用重试
+//pop：只能有一个线程调用，从tail_往后取。某个生产者exchange完还没来得及写next时，pop会暂时看到队列是空的，
+//调用者如果另外知道队列里有东西(比如Strand的计数)，让一下CPU再试就行
+//T要能默认构造：队列里始终有一个已经取走了值的哑节点
+//Padded：head_和tail_各占一个缓存行，生产者和消费者不会伪共享；大量很少用到的队列(比如actor的邮箱)关掉省内存
+template<typename T, bool Padded = true>
+class MpscQueue
+{
+public:
+    MpscQueue()
+    {
+        Node* stub = new Node();
+        head_.store(stub, std::memory_order_relaxed);
+        tail_ = stub;
+    }
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(value))
+        {
+        }
+        delete tail_;
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value)
+    {
+        Node* node = new Node();
+        node->value = std::move(value);
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+    //只能由消费者调用，没有取到返回false
+    bool pop(T& value)
+    {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr)
+        {
+            return false;
+        }
+        //next变成新的哑节点
+        value = std::move(next->value);
+        next->value = T();
+        tail_ = next;
+        delete tail;
+        return true;
+    }
+private:
+    struct Node
+    {
+        std::atomic<Node*> next{nullptr};
+        T value{};
+    };
+    static const size_t ALIGN = Padded ? 64 : alignof(Node*);
+    alignas(ALIGN) std::atomic<Node*> head_;
+    alignas(ALIGN) Node* tail_;
+};
+
+#endif //MPSC_QUEUE_H
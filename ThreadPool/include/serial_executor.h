@@ -0,0 +1,60 @@
+#ifndef SERIAL_EXECUTOR_H
+#define SERIAL_EXECUTOR_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "mpsc_queue.h"
+
+class ThreadPool;
+
+//Strand和Actor共用的串行执行核心：元素(任务、消息)放在派生类自己的MpscQueue里，这里只管计数和调度
+//post()让pending_从0变1的那个生产者负责往线程池里投一个激活任务，同一时刻最多只有一个激活在排队或执行，
+//它一个接一个处理元素，所以同一个执行器的元素不会被并发处理，也不需要任何锁
+//一次激活最多处理batch个，还有剩下的就重新排到线程池队尾，一个很忙的执行器不会一直占着一个线程
+//激活在队列里被取消(shutdown(CANCEL_PENDING)、DROP_OLDEST)时，排着的元素全部丢弃
+//必须由shared_ptr持有，生命周期不能超过线程池；激活执行完之前执行器不会析构
+class SerialExecutor : public std::enable_shared_from_this<SerialExecutor>
+{
+public:
+    SerialExecutor(const SerialExecutor&) = delete;
+    SerialExecutor& operator=(const SerialExecutor&) = delete;
+    //已经提交还没处理完的元素数
+    int64_t pending() const { return pending_.load(std::memory_order_relaxed); }
+protected:
+    SerialExecutor(ThreadPool& pool, int batch);
+    virtual ~SerialExecutor() = default;
+    //派生类把元素放进队列之后调用；投不进线程池(shutdown、队列满)就在提交线程里直接处理
+    void post();
+    //从队列里取出并处理一个元素，只会在一个线程里调用
+    virtual void processOne() = 0;
+    //从队列里取出并丢弃一个元素
+    virtual void discardOne() = 0;
+    //pending_说明有元素，只是生产者还没把节点链上，等它一下
+    template<typename T, bool Padded>
+    static T popPending(MpscQueue<T, Padded>& queue)
+    {
+        T value;
+        while (!queue.pop(value))
+        {
+            std::this_thread::yield();
+        }
+        return value;
+    }
+
+    ThreadPool& pool_;
+private:
+    //在线程池里执行的激活任务
+    class Activation;
+    //第一次激活和普通任务一样走拒绝策略，投不进去返回false
+    bool schedule();
+    //处理元素直到pending_归零，或者这一批处理够了重新排队
+    void drain();
+    //激活被取消，丢掉所有元素，和drain一样负责到pending_归零
+    void dropAll();
+
+    int batch_;
+    std::atomic<int64_t> pending_; //已经提交还没处理完的元素数，从0变1的提交者负责schedule
+};
+
+#endif //SERIAL_EXECUTOR_H
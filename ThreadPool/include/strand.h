@@ -0,0 +1,31 @@
+#ifndef STRAND_H
+#define STRAND_H
+#include <memory>
+#include "mpsc_queue.h"
+#include "serial_executor.h"
+
+class Task;
+class Result;
+class ThreadPool;
+
+//串行执行器：提交到同一个Strand的任务按提交顺序一个接一个执行，绝不会同时执行，不同Strand之间并行
+//用来代替"每个任务自己拿一把会话锁"：那样抢不到锁的工作线程只能干等
+//任务先进无锁的MpscQueue，调度和Actor一样由SerialExecutor负责：同一时刻最多只有一个drain任务在排队或执行，
+//它把队列里的任务依次执行完，所以同一个key的任务不需要任何锁；一次drain最多执行STRAND_BATCH个任务
+//由ThreadPool::strand(key)创建，Strand的生命周期不能超过线程池
+class Strand : public SerialExecutor
+{
+public:
+    explicit Strand(ThreadPool& pool);
+
+    //和ThreadPool::submitTask一样返回Result；线程池已经shutdown或者队列满时，drain直接在提交线程里执行
+    Result submitTask(std::shared_ptr<Task> sp);
+private:
+    void processOne();
+    //drain任务被取消，这个Strand里排着的任务一起取消
+    void discardOne();
+
+    MpscQueue<std::shared_ptr<Task>> queue_;
+};
+
+#endif //STRAND_H
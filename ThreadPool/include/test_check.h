@@ -0,0 +1,95 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include "threadpool.h"
+
+//测试程序共用的检查：失败时打印位置和条件，不中断，接着检查后面的
+//main最后return testResult()，有失败返回1，ctest按返回值判断通过没有
+inline int& testFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond) \
+    do \
+    { \
+        if (!(cond)) \
+        { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+            testFailures()++; \
+        } \
+    } while (0)
+
+//等cond成立，最多等timeout；线程池里的事情是异步发生的，不能读一次就下结论
+inline bool waitFor(const std::function<bool()>& cond, std::chrono::milliseconds timeout = std::chrono::seconds(5))
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!cond())
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+//一直执行到release变成true，用来占住工作线程，让后面的任务只能在队列里排着
+//release是所有BlockTask共用的，每个用例开始时置false，结束前置true
+class BlockTask : public Task
+{
+public:
+    Any run()
+    {
+        while (!release)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return 0;
+    }
+    static inline std::atomic_bool release{false};
+};
+
+//睡time之后返回id，done不为空时执行完加1
+class SleepTask : public Task
+{
+public:
+    explicit SleepTask(std::chrono::milliseconds time = std::chrono::milliseconds(1), int id = 0, std::atomic_int* done = nullptr)
+        : time_(time)
+        , id_(id)
+        , done_(done)
+    {}
+    Any run()
+    {
+        std::this_thread::sleep_for(time_);
+        if (done_ != nullptr)
+        {
+            (*done_)++;
+        }
+        return id_;
+    }
+    int getId() const { return id_; }
+private:
+    std::chrono::milliseconds time_;
+    int id_;
+    std::atomic_int* done_;
+};
+
+inline int testResult()
+{
+    if (testFailures() == 0)
+    {
+        std::cout << "all checks passed" << std::endl;
+        return 0;
+    }
+    std::cout << testFailures() << " check(s) failed" << std::endl;
+    return 1;
+}
+
+#endif //TEST_CHECK_H
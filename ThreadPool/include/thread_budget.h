@@ -0,0 +1,61 @@
+#ifndef THREAD_BUDGET_H
+#define THREAD_BUDGET_H
+#include <mutex>
+#include <string>
+#include <vector>
+
+//每个成员的统计，ThreadBudget::stats()
+struct BudgetMemberStats
+{
+    int id;
+    std::string name;
+    int minThreads;
+    int maxThreads;
+    int threads; //当前借到的线程数
+};
+
+//进程级的线程预算：几个线程池(舱壁，bulkhead)共用total个线程，而不是每个线程池都按自己独占整台机器开线程
+//每个成员登记时保证最少minThreads个线程(预留出来，别人借不走)，最多maxThreads个；
+//超过min的部分从公共的余量里借，谁先要谁先得，空闲线程被回收时还回去
+//总线程数 = sum(max(threads, min)) <= total，可运行的线程数就不会比核数多太多
+//线程安全，线程池持有自己的taskQueMtx_时调用，这里不会回调线程池
+class ThreadBudget
+{
+public:
+    explicit ThreadBudget(int total);
+    ThreadBudget(const ThreadBudget&) = delete;
+    ThreadBudget& operator=(const ThreadBudget&) = delete;
+    //进程默认的预算，第一次用到时按CpuQuota::effectiveCpuCount()创建
+    static ThreadBudget& global();
+
+    //登记一个成员，返回成员id；所有成员的minThreads加起来超过total返回-1
+    int join(const std::string& name, int minThreads, int maxThreads);
+    //成员退出，还没还的线程一起还掉
+    void leave(int member);
+    //成员要加size个线程，返回批准的个数：min以内的直接批准，超过的看公共余量和max
+    int acquire(int member, int size);
+    //成员的线程退出了，还回size个
+    void release(int member, int size);
+
+    int getTotal() const;
+    std::vector<BudgetMemberStats> stats() const;
+private:
+    struct Member
+    {
+        std::string name;
+        int minThreads;
+        int maxThreads;
+        int threads;
+        bool joined;
+    };
+    //成员占用的预算：没用满min也要按min算，预留的别人不能借
+    static int charged(const Member& member);
+
+    mutable std::mutex mtx_;
+    int total_;
+    int reserved_; //所有成员的minThreads之和
+    int committed_; //所有成员charged()之和，<= total_
+    std::vector<Member> members_; //下标就是成员id，退出的成员不删除
+};
+
+#endif //THREAD_BUDGET_H
@@ -10,6 +10,18 @@
 #include <functional>
 #include <iostream>
 #include <unordered_map>
+#include <list>
+#include <chrono>
+#include <string>
+#include <typeinfo>
+#include <exception>
+#include "hill_climbing.h"
+#include "histogram.h"
+#include "cancellation.h"
+#include "token_bucket.h"
+#include "fair_queue.h"
+#include "strand.h"
+#include "thread_budget.h"
 //不要用using namespace std
 
 //Any类型：可以接收和返回任意类型
@@ -17,6 +29,13 @@
 当一个模板不被用到的时侯，它就不该被实例化出来。这就表示Test.cpp.o中没有test函数的定义。
 所以模版类的定义和实现写在.h中，不要分开写
 */
+//Any::cast_的类型和存进去的不一致，或者Any是空的(没有执行的任务的Result::get()返回空的Any)
+class BadAnyCast : public std::bad_cast
+{
+public:
+    const char* what() const noexcept override { return "type is unmatch!"; }
+};
+
 class Any
 {
 public:
@@ -45,10 +64,12 @@ public:
         Derive<T>* pd = dynamic_cast<Derive<T>*>(base_.get());
         if (pd == nullptr)//如果类型不匹配，就无法转化成功
         {
-            throw "type is unmatch!" ;
+            throw BadAnyCast();
         }
         return pd->data_;
     }
+    //有没有存值
+    bool hasValue() const { return base_ != nullptr; }
 private:
     //基类类型
     class Base
@@ -104,25 +125,88 @@ private:
 
 //Task类型的前置声明
 class Task;
+//submitTask的结果，Result::getStatus()返回
+enum class SubmitStatus
+{
+    ACCEPTED, //进入了任务队列
+    RAN_IN_CALLER, //队列满，按CALLER_RUNS在提交线程里执行完了
+    QUEUE_FULL, //队列满被拒绝(FAIL_FAST，或者BLOCK_TIMEOUT等超时)
+    SHED, //排队延迟超标，低优先级任务被准入控制拒绝
+    RATE_LIMITED, //所属的提交类别没有令牌了
+    SHUT_DOWN, //线程池已经shutdown
+};
+//Result::get()返回之后任务的结局，Result::getState()返回
+enum class ResultState
+{
+    OK, //执行完了，get()返回run的返回值
+    FAILED, //run抛了异常，get()把它重新抛出来
+    CANCELLED, //进了队列但没有执行(shutdown丢弃、DROP_OLDEST、取消令牌、准入控制)
+    REJECTED, //没有提交成功，原因看getStatus()
+    INVALID, //Result已经被移走，不对应任何任务
+};
 //实现接受提交到线程池的task任务执行完成后的返回值类型Result
 class Result
 {
 public:
-    // error: use of deleted function ‘Result::Result(const Result&)，因为Result的拷贝构造函数被禁止了·
-    //解决这个问题，就是把Result的拷贝构造函数和赋值构造函数都禁止掉
-    //如何解决这个问题？
-    Result(std::shared_ptr<Task> task, bool isValid = true);
+    //返回值存放在Task里，Result只持有task的强智能指针，所以Result可以移动，
+    //用户不接收submitTask的返回值(Result临时对象马上析构)也不会让线程写到已经析构的对象上
+    Result(std::shared_ptr<Task> task, SubmitStatus status = SubmitStatus::ACCEPTED);
     ~Result() = default;
-    void setVal(Any any);
-    //问题1：setVal方法，获取任务执行完的返回值(任务执行完，它的返回值在哪)
+    Result(const Result&) = delete;
+    Result& operator=(const Result&) = delete;
+    Result(Result&&) = default;
+    Result& operator=(Result&&) = default;
     
-    //问题2：get方法，用户调用这个方法获取task的返回值(怎么拿到任务执行的run的返回值,存在Result对象的Any)
+    //get方法，用户调用这个方法获取task的返回值(任务执行完，返回值存在Task对象的Any里)
+    //任务还在队列里没被工作线程取走的话，get()把它领过来直接在调用线程里执行，不用等工作线程，也省掉两次线程切换
+    //(在PoolStats::steals里计数)。它从队列里拿掉，统计、trace、watchdog、租户配额和工作线程执行的一样算；
+    //执行时currentWorker()是一个threadId为-1的空上下文。设置了onWorkerStart的线程池不这样做，任务可能要用工作线程的资源
+    //任务在shutdown时被丢弃或者被取消令牌跳过的话，get()不会一直阻塞，返回空的Any(hasValue()为false)，原因看getState()
+    //run抛出的异常在工作线程里用exception_ptr存下来，在这里原样重新抛出
     Any get();
+    ResultState getState() const;
+    //任务是否没有执行(被shutdown丢弃、被DROP_OLDEST挤掉或者出队时token已经取消)，get()返回之后判断
+    bool isCancelled() const;
+    //提交有没有成功，QUEUE_FULL、SHED、RATE_LIMITED和SHUT_DOWN时get()直接返回空值
+    SubmitStatus getStatus() const { return status_; }
 private:
-    Any any_; //存储任务的返回值
-    Semaphore sem_;//线程通信信号量
     std::shared_ptr<Task> task_;//指向对应获取返回值的任务对象, task的引用计数不为0, 则task不会析构
-    std::atomic_bool isValid_; //返回值是否有效，如果任务已经提交失败了，返回值肯定是无效的
+    bool isValid_; //返回值是否有效，如果任务已经提交失败了，返回值肯定是无效的
+    SubmitStatus status_;
+};
+
+//任务优先级，准入控制(setAdmissionControl)过载时只丢弃LOW的任务
+enum class TaskPriority
+{
+    LOW,
+    NORMAL,
+};
+
+//提交类别：同一类的生产者(比如日志压缩、缓存预热)共用一个令牌桶，只能用线程池的一部分吞吐量
+//由ThreadPool::defineSubmitClass创建，线程池析构前一直有效。限速在submitTask拿锁之前做，不占taskQueMtx_
+class SubmitClass
+{
+public:
+    SubmitClass(const std::string& name, double rate, double burst)
+        : name_(name)
+        , bucket_(rate, burst)
+        , admitted_(0)
+        , rejected_(0)
+        , waited_(0)
+    {}
+    const std::string& getName() const { return name_; }
+    //运行期间可以修改，rate <= 0表示不限速
+    void setRate(double rate, double burst) { bucket_.setRate(rate, burst); }
+    uint64_t getAdmitted() const { return admitted_.load(std::memory_order_relaxed); } //拿到令牌的提交数
+    uint64_t getRejected() const { return rejected_.load(std::memory_order_relaxed); } //没有令牌被拒绝的提交数
+    uint64_t getWaited() const { return waited_.load(std::memory_order_relaxed); } //等过令牌的提交数
+private:
+    friend class ThreadPool;
+    std::string name_;
+    TokenBucket bucket_;
+    std::atomic<uint64_t> admitted_;
+    std::atomic<uint64_t> rejected_;
+    std::atomic<uint64_t> waited_;
 };
 
 //任务抽象基类
@@ -130,15 +214,144 @@ private:
 class Task
 {
 public:
-    Task();
-    ~Task() = default;
+    Task() = default;
+    virtual ~Task() = default;
     // virtual void run() = 0;                                                                                                                                                                                                                                                                                             
     void exec();//不会多态
-    void setResult(Result* res);
+    //任务名，显示在Chrome trace的slice上。只保存指针，name要一直有效(一般用字符串常量)
+    void setName(const char* name) { name_ = name; }
+    const char* getName() const { return name_; }
+    //软超时：执行超过timeout还没结束，watchdog通过setStuckTaskHandler的回调报告，任务不会被打断
+    void setTimeout(std::chrono::milliseconds timeout) { timeout_ = timeout; }
+    std::chrono::milliseconds getTimeout() const { return timeout_; }
+    void setPriority(TaskPriority priority) { priority_ = priority; }
+    TaskPriority getPriority() const { return priority_; }
+    //按submitClass限速，没有令牌时waitForToken为true就在submitTask里等，否则返回RATE_LIMITED
+    void setSubmitClass(SubmitClass* submitClass, bool waitForToken = false)
+    {
+        submitClass_ = submitClass;
+        waitForToken_ = waitForToken;
+    }
+    //所属租户(ThreadPool::registerTenant的返回值)，不设置是FairTaskQueue::DEFAULT_TENANT
+    void setTenant(int tenant) { tenant_ = tenant; }
+    int getTenant() const { return tenant_; }
+    //提交时带的取消令牌，run里可以检查getToken().stop_requested()提前返回
+    const CancellationToken& getToken() const { return token_; }
     virtual Any run() = 0;//多态调用。virtual 和 虚函数不能放在一块， 任务的返回值在这                                                                                                                                                                                                                                                                                               
 private:
-    //这里不能用智能指针，否则会和Result发生交叉引用
-    Result* result_;//Result对象的生命周期 > Task对象生命周期
+    //任务不执行了(shutdown丢弃、DROP_OLDEST、取消令牌、准入控制)：标记cancelled_，唤醒Result::get()
+    //SerialExecutor(Strand、Actor)的激活重写它，把排着的任务、消息一起取消
+    virtual void cancel();
+    //工作线程和Result::get()抢着执行队列里的任务，返回true的一方执行(或者取消)它
+    bool claim() { return !claimed_.exchange(true, std::memory_order_acq_rel); }
+private:
+    friend class Result;
+    friend class ThreadPool;
+    friend class Strand;
+    friend class SerialExecutor;
+    Any any_; //存储任务的返回值
+    std::exception_ptr exception_; //run抛出的异常，Result::get()重新抛出
+    std::chrono::steady_clock::time_point enqueueTime_; //进入任务队列的时间，用来统计排队时间
+    const char* name_ = nullptr;
+    bool cancelled_ = false; //还没执行就被shutdown丢弃或者被取消，sem_照样post，持有taskQueMtx_时写
+    CancellationToken token_;
+    std::chrono::milliseconds timeout_{0}; //0表示不检查
+    TaskPriority priority_ = TaskPriority::NORMAL;
+    SubmitClass* submitClass_ = nullptr;
+    bool waitForToken_ = false;
+    int tenant_ = FairTaskQueue::DEFAULT_TENANT;
+    std::atomic_bool claimed_{false}; //已经被领走执行或者取消
+    //submitTask放进taskQue_时设置，Result::get()只领这样的任务；Strand里排队的任务、有onWorkerStart的线程池不设置
+    //只在领到任务之后访问：领到说明它还在队列里，线程池的shutdown会等get()执行完，这个指针一直有效
+    ThreadPool* pool_ = nullptr;
+    Semaphore sem_;//线程通信信号量，任务执行完post，Result::get在上面wait
+};
+
+//每个工作线程自己的统计，只有这个线程写，不用加锁；按缓存行对齐，不同线程的计数不会伪共享
+struct alignas(64) WorkerStats
+{
+    WorkerStats();
+    //单写者计数，不需要原子的读-改-写
+    static void increment(std::atomic<uint64_t>& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    std::atomic<uint64_t> tasksExecuted; //执行的任务数
+    std::atomic<uint64_t> parks; //没有任务挂起等待的次数
+    std::atomic<uint64_t> tasksCancelled; //出队时token已经取消、没有执行的任务数
+    std::atomic<uint64_t> tasksFailed; //run抛了异常的任务数
+    LatencyHistogram waitTime; //任务在队列里的排队时间(ns)
+    LatencyHistogram runTime; //任务的执行时间(ns)
+};
+
+//统计快照，读的时候才合并
+struct WorkerStatsSnapshot
+{
+    WorkerStatsSnapshot();
+    void add(const WorkerStats& stats);
+    void add(const WorkerStatsSnapshot& other);
+    int threadId; //-1表示已经退出的线程的合计
+    uint64_t tasksExecuted;
+    uint64_t parks;
+    uint64_t tasksCancelled;
+    uint64_t tasksFailed;
+    HistogramSnapshot waitTime;
+    HistogramSnapshot runTime;
+};
+
+struct PoolStats
+{
+    int queueDepth; //当前排队的任务数
+    int maxQueueDepth; //任务队列出现过的最大长度
+    int threadSize; //当前线程数
+    int idleThreadSize; //当前空闲线程数
+    uint64_t rejected; //提交失败的任务数(队列满被拒绝或者已经shutdown)
+    uint64_t blocked; //提交时因为队列满等待过的次数(BLOCK/BLOCK_TIMEOUT)
+    uint64_t callerRuns; //队列满时在提交线程里执行的任务数(CALLER_RUNS)
+    uint64_t dropped; //被新任务挤出队列的任务数(DROP_OLDEST)
+    uint64_t shed; //准入控制丢弃的低优先级任务数(提交时拒绝的和出队时不执行的)
+    bool overloaded; //准入控制当前是否判定过载
+    uint64_t steals; //不经过工作线程、被别的线程拿去执行的任务数
+    uint64_t lockAcquired; //taskQueMtx_被拿到的次数(不含条件变量醒来时重新加锁)
+    uint64_t lockContended; //其中第一次try_lock失败、需要等别人放锁的次数
+    uint64_t stuckTasks; //watchdog报告的超时任务数
+    int cpuCount; //setAutoSize时最近一次读到的可用CPU数，没开为0
+    std::vector<TenantStats> tenants; //每个租户排队、执行的任务数和占用的执行时间
+    WorkerStatsSnapshot total; //所有线程(包括已经退出的)和Result::get()自己执行的任务的合计
+    std::vector<WorkerStatsSnapshot> workers; //当前每个线程各自的统计
+};
+
+//工作线程的上下文：onWorkerStart里把这个线程自己的资源(缓冲区、随机数发生器、数据库连接)放进来，
+//任务里用ThreadPool::currentWorker()取，每个线程只创建一次，不用每个任务创建，也不用thread_local
+class WorkerContext
+{
+public:
+    explicit WorkerContext(int threadId)
+        : threadId_(threadId)
+        , type_(nullptr)
+    {}
+    int getThreadId() const { return threadId_; }
+    template<typename T>
+    void set(std::shared_ptr<T> data)
+    {
+        data_ = std::move(data);
+        type_ = &typeid(T);
+    }
+    //类型和set时不一样，或者没有set过，返回nullptr
+    template<typename T>
+    T* get() const
+    {
+        return type_ != nullptr && *type_ == typeid(T) ? static_cast<T*>(data_.get()) : nullptr;
+    }
+    void reset()
+    {
+        data_.reset();
+        type_ = nullptr;
+    }
+private:
+    int threadId_;
+    std::shared_ptr<void> data_;
+    const std::type_info* type_;
 };
 
 //线程类型 
@@ -153,13 +366,48 @@ public:
     ~Thread();
     //启动线程
     void start();
+    //等线程函数返回。线程不能join自己，所以退出的线程把自己交给管理线程或者shutdown去join
+    void join();
     
     //获取线程ID
     int getId() const;
+    WorkerStats& stats() { return stats_; }
+    //正在执行的任务，工作线程写，watchdog(管理线程)读
+    struct RunningTask
+    {
+        std::atomic<int64_t> start{0}; //开始执行的时间(steady_clock的ns)，0表示没有在执行任务
+        std::atomic<int64_t> timeout{0}; //ns，0表示不检查
+        std::atomic<const char*> name{nullptr};
+        int64_t reported = 0; //已经报告过的任务的start，同一个任务只报告一次，只有管理线程访问
+    };
+    RunningTask& runningTask() { return runningTask_; }
+    WorkerContext& context() { return context_; }
 private:
+    WorkerStats stats_;
+    RunningTask runningTask_;
     ThreadFunc func_;
-    static int generateId_;//generateId的目的是为了让id进行更新
+    std::thread thread_;
+    static std::atomic_int generateId_;//generateId的目的是为了让id进行更新，多个线程池会同时创建线程，所以用原子类型
     int threadId_; //cached线程池不可少的,每个线程的id
+    WorkerContext context_; //只有这个线程自己访问
+};
+
+//shutdown的方式
+enum class ShutdownMode
+{
+    DRAIN, //执行完队列里所有任务再退出，析构函数用的就是这种
+    CANCEL_PENDING, //丢弃队列里还没开始的任务，它们的Result::get()返回空值，只等正在执行的任务
+    DEADLINE, //最多等timeout时间让队列排空，到时间还没开始的任务按CANCEL_PENDING处理
+};
+
+//任务队列满了之后submitTask怎么办
+enum class RejectPolicy
+{
+    BLOCK, //一直等到队列有空位
+    BLOCK_TIMEOUT, //最多等setRejectPolicy给的timeout，超时返回QUEUE_FULL，默认就是这种(等1s)
+    FAIL_FAST, //不等，直接返回QUEUE_FULL
+    CALLER_RUNS, //在提交线程里直接执行这个任务，提交者自己被拖慢，天然限流
+    DROP_OLDEST, //丢掉队头最老的任务(它的Result::isCancelled()为true)，新任务入队
 };
 
 //线程池工作模式，类和枚举项都是大驼峰命名法
@@ -168,6 +416,16 @@ enum class PoolMode //加上class后，枚举类型的作用域被限制在类
     MODE_FIXED, //固定大小线程池
     MODE_CACHED, //动态大小线程池
 };
+
+//线程池的可调参数，ThreadPool::getConfig()/reconfigure()整体读写
+struct PoolConfig
+{
+    PoolMode mode;
+    int initThreadSize; //fixed模式的线程数，cached模式的最少线程数
+    int threadSizeThreshold; //cached模式的线程上限
+    int taskQueMaxThreshold; //任务队列上限
+    int threadMaxIdleTime; //cached模式多余线程的最大空闲时间(s)
+};
 /*
 example:
 ThreadPool pool
@@ -188,16 +446,100 @@ public:
     ThreadPool();
     ~ThreadPool();
     //线程池的工作模式
-    void setMode(PoolMode mode);
+    //下面这几个参数运行期间都可以修改，改完立刻生效：线程多了让空闲线程退出(正在执行任务的执行完再退)，
+    //少了马上创建，队列上限调大了唤醒等着的提交者
+    //参数不合法(线程数、队列上限、空闲时间<=0，initThreadSize > threadSizeThreshold)时不修改，返回false
+    bool setMode(PoolMode mode);
     //设置task任务队列上限的阈值
-    void setTaskQueMaxThreshold(int threshold);
-    void setInitThreadSize(int size);
-    void setThreadSizeThreshold(int threshold);//设置线程上限阈值
+    bool setTaskQueMaxThreshold(int threshold);
+    //start()之前设置的话，start()不给参数就按它创建线程
+    bool setInitThreadSize(int size);
+    bool setThreadSizeThreshold(int threshold);//设置线程上限阈值
+    //一次改多个参数，在一把锁里全部生效，工作线程不会看到改了一半的配置
+    //开了setAutoSize的话，配额变化时initThreadSize和threadSizeThreshold还会被重新计算
+    bool reconfigure(const PoolConfig& config);
+    //当前配置的快照，不拿锁
+    PoolConfig getConfig() const;
+    //任务队列满时的处理方式，timeout只对BLOCK_TIMEOUT有效，运行期间也可以修改
+    void setRejectPolicy(RejectPolicy policy, std::chrono::milliseconds timeout = std::chrono::seconds(1));
+    //key相同的任务按提交顺序串行执行，不同key之间并行，见Strand
+    //没有人持有、也没有待执行任务的Strand会被释放，下次同一个key再创建一个新的
+    std::shared_ptr<Strand> strand(uint64_t key);
+    Result submitKeyed(uint64_t key, std::shared_ptr<Task> sp);
+    //多租户：注册一个租户，返回租户id，用Task::setTenant提交到这个租户。同名的已经存在就修改权重
+    //每个租户一个队列，线程取任务时按权重在租户之间分配执行时间(DRR)，运行期间可以注册和修改权重
+    int registerTenant(const std::string& name, int weight);
+    bool setTenantWeight(int tenant, int weight);
+    //创建名为name的提交类别，限速rate个/s，最多攒burst个；同名的已经存在就修改它的限速
+    SubmitClass* defineSubmitClass(const std::string& name, double rate, double burst);
+    //没有这个名字返回nullptr
+    SubmitClass* getSubmitClass(const std::string& name);
+    //按排队延迟做准入控制(CoDel)：出队时量每个任务的排队时间，连续interval时间里排队时间都超过target就判定过载，
+    //过载期间新提交的TaskPriority::LOW任务返回SHED，已经在排队的LOW任务出队时直接丢弃；
+    //有一个任务排队时间回到target以下就解除过载。target为0表示关闭(默认)，运行期间也可以修改
+    void setAdmissionControl(std::chrono::milliseconds target, std::chrono::milliseconds interval = std::chrono::milliseconds(100));
+    //从进程级的线程预算里借线程(舱壁)：保证最少minThreads个，最多maxThreads个，超过min的部分别的线程池没用才借得到
+    //设置后initThreadSize = minThreads，threadSizeThreshold = maxThreads，start()的参数和setAutoSize不再起作用
+    //要在start()之前设置，budget要比线程池活得久；min加起来超过预算返回false
+    bool setThreadBudget(ThreadBudget& budget, const std::string& name, int minThreads, int maxThreads);
+    //进程默认的线程池，第一次调用时创建并启动：cached模式，从ThreadBudget::global()借线程，最少1个，最多整个预算
+    //进程退出时把队列里的任务执行完再析构
+    static ThreadPool& global();
+    //自动确定线程数：按cgroup配额和亲和性掩码算出可用CPU数，决定初始线程数和cached模式的线程上限
+    //开启后start()的参数被忽略，运行期间配额变化时管理线程会重新调整线程数
+    void setAutoSize(bool enable);
+    //cached模式下用爬山法按实测吞吐量增减线程，代替"任务数 > 空闲线程数就加线程"
+    //线程数在[initThreadSize, threadSizeThreshold]之间调整
+    void setAdaptive(bool enable);
+    //cached模式预先创建并挂起size个备用线程，需要加线程时直接唤醒一个，不用在提交任务时现场创建
+    void setReserveThreadSize(int size);
+    //cached模式下超过initThreadSize的线程空闲多久(s)被回收，运行期间也可以修改
+    bool setThreadMaxIdleTime(int seconds);
+    //休眠：整个线程池空闲seconds秒后退出所有线程(包括init线程和管理线程)，0表示不休眠
+    //休眠后第一次submitTask会自动重新创建线程，冷启动耗时记在HibernateStat里
+    void setHibernateTime(int seconds);
+    struct HibernateStat
+    {
+        int hibernateCount; //休眠次数
+        int wakeCount; //唤醒次数
+        std::chrono::nanoseconds lastColdStart; //最近一次唤醒：从submitTask到第一个任务开始执行的时间
+        std::chrono::nanoseconds totalColdStart; //所有唤醒的冷启动时间之和
+    };
+    HibernateStat getHibernateStat();
+    //每个工作线程开始取任务前调用onWorkerStart，退出前调用onWorkerStop，都在这个线程自己里面调用，不持锁
+    //cached模式后来加的线程、休眠唤醒后重新创建的线程也一样。要在start()之前设置
+    void onWorkerStart(std::function<void(WorkerContext&)> hook);
+    void onWorkerStop(std::function<void(WorkerContext&)> hook);
+    //当前线程的上下文，不是线程池的工作线程(比如CALLER_RUNS时的提交线程)返回nullptr，Result::get()自己执行任务时见Result::get()
+    static WorkerContext* currentWorker();
+    //超时任务的信息
+    struct StuckTask
+    {
+        const char* name; //Task::setName设置的名字，没有为nullptr
+        int threadId; //执行它的线程，-1表示在Result::get()的调用者线程里执行
+        std::chrono::nanoseconds duration; //已经执行了多久
+        std::chrono::milliseconds timeout; //Task::setTimeout设置的超时
+    };
+    //watchdog：管理线程每隔一段时间检查每个线程正在执行的任务，设了超时并且超时的任务调用handler报告一次
+    //handler在管理线程里调用(不持锁)，不要在里面阻塞太久。要在start()之前设置
+    void setStuckTaskHandler(std::function<void(const StuckTask&)> handler);
+    //cached模式下发现超时任务时额外创建一个线程顶替被卡住的线程，多出来的线程空闲后照常回收
+    void setStuckCompensation(bool enable);
+    //当前线程总数
+    int getCurThreadSize() const;
+    //统计快照：队列长度、排队/执行时间直方图、每个线程执行的任务数和挂起次数、提交失败数
+    //工作线程更新统计不加锁，只有读快照时拿一下taskQueMtx_
+    PoolStats stats();
     //给线程池添加任务
     // void submitTask(std::shared_ptr<Task> sp);
     Result submitTask(std::shared_ptr<Task> sp);
-    //开始线程池
-    void start(int initThreadSize = 4);
+    //带取消令牌提交，token取消后任务还没开始就不再执行
+    Result submitTask(std::shared_ptr<Task> sp, CancellationToken token);
+    //开始线程池，initThreadSize <= 0表示用setInitThreadSize设置的值(默认4)
+    void start(int initThreadSize = 0);
+    //关闭线程池：不再接受新任务，按mode处理队列里的任务，然后join所有线程，返回被丢弃的任务数
+    //正在执行的任务没法打断，总是等它们执行完；只能关一次，之后再调用直接返回0
+    int shutdown(ShutdownMode mode = ShutdownMode::DRAIN, std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
     void threadFunc(int threadid);
     //线程池之所以要禁止拷贝构造和赋值构造，是因为线程池的生命周期是由用户控制的，
     //如果允许拷贝构造和赋值构造，那么就会出现多个线程池同时运行的情况
@@ -207,6 +549,57 @@ public:
 private:
     //定义线程函数
     void threadHandler();
+    //创建并启动size个线程，spare为true时创建的是备用线程
+    //lock必须持有taskQueMtx_，启动线程期间会临时放锁
+    void addThreads(std::unique_lock<std::mutex>& lock, int size, bool spare = false);
+    //备用线程函数：挂起等待被唤醒，唤醒后执行threadFunc
+    void spareThreadFunc(int threadid);
+    //管理线程：创建线程、补充备用线程、周期性地重新读取CPU配额、调整cached模式的线程数
+    void supervisorFunc();
+    //根据上一个周期的吞吐量调整线程数
+    void adjustThreadSize(std::unique_lock<std::mutex>& lock, double seconds);
+    //按可用CPU数调整线程数
+    void applyCpuCount(std::unique_lock<std::mutex>& lock, int cpus);
+    //按当前的mode、initThreadSize、threadSizeThreshold增减线程，lock必须持有taskQueMtx_
+    void resizeThreads(std::unique_lock<std::mutex>& lock);
+    //检查config，合法就写进成员变量、发布新的快照并让它生效，不合法返回false。lock必须持有taskQueMtx_
+    bool applyConfig(std::unique_lock<std::mutex>& lock, const PoolConfig& config);
+    //按现在的成员变量生成一个新的快照换掉config_，调用方需持有taskQueMtx_
+    void publishConfig();
+    //需要管理线程的功能开着、它又没在跑就启动它，调用方需持有taskQueMtx_
+    void startSupervisor();
+    //向线程预算要size个线程，返回批准的个数；没有设置预算时全部批准。调用方需持有taskQueMtx_
+    int acquireThreads(int size);
+    //回收空闲超时的线程，调用方需持有taskQueMtx_
+    void reapIdleThreads(std::chrono::steady_clock::time_point now);
+    //线程退出时从线程池中删除自己，调用方需持有taskQueMtx_
+    void removeThread(int threadid);
+    //线程对象挪到exitedThreads_，等别的线程join，调用方需持有taskQueMtx_
+    void releaseThread(int threadid);
+    friend class Result;
+    friend class SerialExecutor;
+    //执行一个已经领到的任务：排队时间、执行时间、trace、watchdog记录都在这里，工作线程和Result::get()共用
+    //concurrent表示stats有多个线程在写，返回执行时间(ns)，调用方拿锁以后记到租户上
+    int64_t runTask(Task* task, WorkerStats& stats, bool concurrent, Thread::RunningTask& running,
+        std::chrono::steady_clock::time_point startTime);
+    //Result::get()领到了还在队列里的任务，在调用者线程执行它。shutdown会等它执行完，线程池在这期间不会析构
+    void runStolen(const std::shared_ptr<Task>& task);
+    //SerialExecutor(Strand、Actor)的激活重新排队：已经被接收过的任务，不检查队列上限和拒绝策略，shutdown之后返回false
+    bool requeue(std::shared_ptr<Task> sp);
+    //出队时用这个任务的排队时间更新准入控制状态，返回是否过载，持有taskQueMtx_、任务已经从taskQue_取出后调用
+    bool updateAdmission(std::chrono::steady_clock::duration sojourn, std::chrono::steady_clock::time_point now);
+    //join已经退出的线程，lock必须持有taskQueMtx_，join期间会临时放锁
+    void joinExitedThreads(std::unique_lock<std::mutex>& lock);
+    //watchdog检查超时任务，lock必须持有taskQueMtx_，调用handler期间会临时放锁
+    void checkStuckTasks(std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point now);
+    //线程池进入休眠，lock必须持有taskQueMtx_：让所有线程退出，等它们退出后join掉(期间放锁)
+    //返回true表示已经休眠，管理线程可以退出；等的时候被wakeUp()或者shutdown打断返回false
+    bool hibernate(std::unique_lock<std::mutex>& lock);
+    //从休眠中唤醒，重新启动管理线程，由它创建工作线程，调用方需持有taskQueMtx_
+    void wakeUp();
+
+    //拿taskQueMtx_，顺便统计锁竞争：先try_lock，失败了才算一次竞争
+    std::unique_lock<std::mutex> lockQueue();
 
     //检查pool的运行的状态, 为成员函数服务的函数，要为private模式
     bool checkRunningState() const;
@@ -214,13 +607,15 @@ private:
     //线程相关
     // std::vector<std::unique_ptr<Thread>>  threads_;// 如果用裸指针不会自动释放，改为智能指针,会自动释放new出来的内存
     std::unordered_map<int, std::unique_ptr<Thread>> threads_;//每个id对应1个thread
+    std::vector<std::unique_ptr<Thread>> exitedThreads_; //线程函数已经返回、还没join的线程
     size_t initThreadSize_; //初始化线程数量, size_t是unsigned int类型无符号整数
     int threadSizeThreshold_;//线程数量上限阈值 , 不能够无限增加线程数量
     std::atomic_int  curThreadSize_;//记录当前线程池里面线程总数量，由于线程数量会改变，所以得用原子类型
     std::atomic_int  idleThreadSize_;//记录空闲线程的数量， 由于空闲线程数量会改变，所以得用原子类型
+    int retireThreadSize_;//需要退出的空闲线程数量，线程数缩容时由空闲线程自己领取退出
 
     //任务相关
-    std::queue<std::shared_ptr<Task>> taskQue_; //任务队列,之所用指针是因为任务类型不确定，可能是任意类型
+    FairTaskQueue taskQue_; //任务队列,之所用指针是因为任务类型不确定，可能是任意类型；每个租户一个FIFO
     //concreteTask的run方法中，可以通过dynamic_cast转换为具体类型，将传入对象的生命周期延长，所以要用强智能指针
     std::atomic_int taskSize_; //任务数量
     int taskQueMaxThreshold_; //任务队列上限阈值
@@ -229,10 +624,100 @@ private:
     std::mutex taskQueMtx_; //互斥锁
     std::condition_variable notFull_;//表示任务队列不满的条件变量
     std::condition_variable notEmpty_;//表示任务队列不空的条件变量
-    std::condition_variable exitCond_; //等待线程资源回收 
     //线程池状态
     PoolMode  poolMode_;
     std::atomic_bool isPoolRunning_;//当前线程池的启动状态
+    //上面这些参数的只读快照，持锁修改参数后整体换掉一个新的，getConfig()用std::atomic_load读，不用拿锁
+    std::shared_ptr<const PoolConfig> config_;
+    bool isShutdown_; //调用过shutdown，不再接受任务
+
+    //线程预算相关
+    ThreadBudget* budget_; //借线程的预算，nullptr表示不受限
+    int budgetMember_; //在budget_里的成员id
+    int budgetDeficit_; //预算不够、被拒绝的线程数，管理线程每BUDGET_RETRY_INTERVAL重试一次
+
+    //自动确定线程数相关
+    bool autoSize_; //是否按CPU配额自动确定线程数
+    int cpuCount_; //上一次读到的可用CPU数
+    std::thread supervisor_; //管理线程，只在需要时启动
+    std::condition_variable supervisorCond_; //唤醒管理线程(需要加线程、退出时)
+    int growThreadSize_; //submitTask请求管理线程创建、还没创建的线程数
+
+    //备用线程相关
+    int reserveThreadSize_; //需要保持的备用线程数
+    int spareThreadSize_; //当前挂起的备用线程数，不计入curThreadSize_
+    int spareActivateSize_; //已经分配出去、还没醒来的备用线程数
+    std::condition_variable spareCond_; //备用线程挂起在这里
+
+    //空闲线程回收相关
+    struct IdleThread
+    {
+        std::chrono::steady_clock::time_point since; //什么时候开始空闲
+        bool retire; //被管理线程选中回收
+    };
+    std::list<IdleThread> idleThreads_; //cached模式的空闲线程，按开始空闲的先后排序，每个线程持有自己那一项的迭代器
+    std::list<IdleThread> retiringThreads_; //已被选中回收、还没醒来退出的线程
+    int threadMaxIdleTime_; //线程最大空闲时间(s)
+    bool supervisorReschedule_; //期限变了，管理线程需要重新计算醒来的时间
+
+    //休眠相关
+    int hibernateTime_; //整个线程池空闲多久(s)后休眠，0表示不休眠
+    bool hibernating_; //是否在休眠
+    bool supervisorExited_; //管理线程休眠后已经返回，wakeUp()要重新启动它
+    std::chrono::steady_clock::time_point poolIdleSince_; //最后一个忙碌的线程变空闲的时间
+    std::chrono::steady_clock::time_point wakeTime_; //唤醒时间，第一个任务开始执行后清零
+    HibernateStat hibernateStat_;
+
+    //自适应线程数相关
+    bool adaptive_; //cached模式是否按吞吐量调整线程数
+    HillClimbing hillClimbing_;
+    std::atomic_int completedTaskSize_; //上一次采样以来完成的任务数
+
+    //统计相关
+    //多个线程都会写的计数单独占一个缓存行，不和上面的成员挤在一起
+    struct alignas(64) SharedCounters
+    {
+        std::atomic<uint64_t> rejected;
+        std::atomic<uint64_t> steals;
+        std::atomic<uint64_t> callerRuns;
+    };
+    SharedCounters counters_;
+    int maxQueueDepth_; //任务队列出现过的最大长度，持有taskQueMtx_时更新
+    RejectPolicy rejectPolicy_;
+    std::chrono::milliseconds rejectTimeout_;
+    uint64_t blockedSize_; //持有taskQueMtx_时更新
+    uint64_t droppedSize_;
+    //准入控制，持有taskQueMtx_时访问
+    std::chrono::steady_clock::duration admissionTarget_;
+    std::chrono::steady_clock::duration admissionInterval_;
+    std::chrono::steady_clock::time_point firstAboveTime_; //排队时间从这个时刻起一直超过target，没有超过时为空
+    bool overloaded_;
+    uint64_t shedSize_;
+    std::unordered_map<std::string, std::unique_ptr<SubmitClass>> submitClasses_; //持有taskQueMtx_时访问
+    //key -> Strand，按key分片，每片一把锁，不占taskQueMtx_；只在strand()/submitKeyed()里访问，工作线程不碰
+    struct alignas(64) StrandShard
+    {
+        std::mutex mtx;
+        std::unordered_map<uint64_t, std::weak_ptr<Strand>> strands;
+        size_t pruneSize = 64; //map长到这么大时清理一次已经释放的Strand
+    };
+    static const int STRAND_SHARDS = 16;
+    StrandShard strandShards_[STRAND_SHARDS];
+    //watchdog相关
+    std::function<void(const StuckTask&)> stuckTaskHandler_;
+    std::function<void(WorkerContext&)> workerStartHook_;
+    std::function<void(WorkerContext&)> workerStopHook_;
+    bool stuckCompensation_; //cached模式为超时任务补一个线程
+    uint64_t stuckTaskSize_; //报告过的超时任务数
+
+    uint64_t lockAcquired_; //持有taskQueMtx_时更新，不需要原子操作
+    uint64_t lockContended_;
+    WorkerStatsSnapshot retiredStats_; //已经退出的线程的统计，线程退出时合并进来
+
+    //Result::get()在调用者线程执行任务相关，持有taskQueMtx_时访问
+    int stealsPending_; //被get()领走、队列里那一项已经被别人取出扔掉，get()还没回来拿锁的任务数
+    std::list<Thread::RunningTask> stolenTasks_; //get()正在执行的任务，watchdog和工作线程的一起检查，shutdown等它们执行完
+    WorkerStats stolenStats_; //get()执行的任务的统计，多个调用者线程都会写
 };
 
 //可以看到unique_lock的锁：
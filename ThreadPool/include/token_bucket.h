@@ -0,0 +1,92 @@
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+//无锁令牌桶：每秒补rate个令牌，最多攒burst个
+//不存"剩几个令牌"，而是存一个时间点tat_(GCRA算法)：桶被取空的那个时刻。
+//每取一个令牌tat_往后推一个间隔(1/rate)，只要tat_不超过 now + burst个间隔 就允许。
+//一个CAS就能完成"补令牌+取令牌"，多个提交线程同时取不需要加锁
+class TokenBucket
+{
+public:
+    TokenBucket(double rate, double burst)
+        : tat_(0)
+    {
+        setRate(rate, burst);
+    }
+    //运行期间可以修改，rate <= 0表示不限速
+    void setRate(double rate, double burst)
+    {
+        int64_t interval = rate > 0 ? static_cast<int64_t>(1e9 / rate) : 0;
+        if (burst < 1)
+        {
+            burst = 1;
+        }
+        tolerance_.store(static_cast<int64_t>(interval * burst), std::memory_order_relaxed);
+        interval_.store(interval, std::memory_order_relaxed);
+    }
+    //拿到令牌返回true，没有令牌立刻返回false
+    bool tryAcquire()
+    {
+        int64_t interval = interval_.load(std::memory_order_relaxed);
+        if (interval == 0)
+        {
+            return true;
+        }
+        int64_t tolerance = tolerance_.load(std::memory_order_relaxed);
+        int64_t now = nowNs();
+        int64_t tat = tat_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            int64_t next = (tat > now ? tat : now) + interval;
+            if (next - now > tolerance)
+            {
+                return false;
+            }
+            //失败时tat被更新成别的线程写进去的值，重新算
+            if (tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+    }
+    //没有令牌就睡到有为止。先把令牌预订下来再睡，等待的线程按先来后到拿到令牌，不会一起醒来再抢
+    //返回等了多久
+    std::chrono::nanoseconds acquire()
+    {
+        int64_t interval = interval_.load(std::memory_order_relaxed);
+        if (interval == 0)
+        {
+            return std::chrono::nanoseconds(0);
+        }
+        int64_t tolerance = tolerance_.load(std::memory_order_relaxed);
+        int64_t now = nowNs();
+        int64_t tat = tat_.load(std::memory_order_relaxed);
+        int64_t next = 0;
+        do
+        {
+            next = (tat > now ? tat : now) + interval;
+        } while (!tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+        int64_t wait = next - now - tolerance;
+        if (wait <= 0)
+        {
+            return std::chrono::nanoseconds(0);
+        }
+        std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+        return std::chrono::nanoseconds(wait);
+    }
+private:
+    static int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    std::atomic<int64_t> tat_; //桶被取空的时刻(steady_clock的ns)
+    std::atomic<int64_t> interval_; //补一个令牌的间隔(ns)，0表示不限速
+    std::atomic<int64_t> tolerance_; //burst个间隔
+};
+
+#endif //TOKEN_BUCKET_H
@@ -0,0 +1,95 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+
+//线程池事件跟踪
+//每个线程往自己的环形缓冲区里写定长的二进制事件，只有这个线程写，不需要锁；缓冲区满了覆盖最旧的事件
+//需要分析时调用Trace::dump()把所有线程的事件按时间排好写到文件，再用trace_dump离线转成文本
+//编译期开关：定义了THREADPOOL_TRACE(cmake -DTHREADPOOL_TRACE=OFF可以关掉)TP_TRACE才会展开，否则什么都不生成
+//运行期开关：Trace::enable()，关闭时TP_TRACE只是一次relaxed load加一次分支
+//Trace::dumpChrome()/trace_dump -c 输出Chrome Trace Event格式的json，可以直接拖进chrome://tracing或ui.perfetto.dev：
+//每个线程一条轨道，任务是一段slice(名字来自Task::setName)，从提交到开始执行画一条flow箭头，挂起/唤醒是瞬时事件
+
+enum class TraceEventType : uint32_t
+{
+    ENQUEUE, //任务进入任务队列，arg = 任务，extra = 任务名
+    DEQUEUE, //线程从任务队列取出任务，arg = 任务
+    START, //任务开始执行，arg = 任务，extra = 任务名
+    FINISH, //任务执行结束，arg = 任务
+    PARK, //线程没有任务，开始等待
+    WAKE, //线程被唤醒
+    SPAWN, //创建线程，arg = 线程池里的线程id
+    EXIT, //线程退出，arg = 线程池里的线程id
+    QUOTA, //管理线程发现可用CPU数变了，arg = 新的CPU数
+};
+
+//写到文件里的事件格式，32字节
+struct TraceEvent
+{
+    uint64_t timestamp; //steady_clock的纳秒数
+    uint64_t arg;
+    uint32_t threadId; //写事件的线程(系统tid)
+    uint32_t type; //TraceEventType
+    uint64_t extra; //任务名(const char*)，没有为0
+};
+
+//extra -> 字符串，dump时把用到的任务名一起写进文件，离线转换时还能查到
+using TraceNameTable = std::unordered_map<uint64_t, std::string>;
+
+//dump文件头
+struct TraceFileHeader
+{
+    char magic[8]; //"TPTRACE"
+    uint32_t version;
+    uint32_t eventSize; //sizeof(TraceEvent)
+    uint64_t eventCount;
+    //version 2起，事件后面跟着任务名表：uint64_t个数，每项uint64_t extra + uint32_t长度 + 字符
+};
+
+class Trace
+{
+public:
+    //运行期开关
+    static void enable(bool on);
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+    //每个线程的环形缓冲区能存多少个事件(向上取2的幂)，只影响之后新分配的缓冲区
+    static void setBufferSize(size_t events);
+    //记录一个事件到当前线程的缓冲区
+    static void record(TraceEventType type, uint64_t arg);
+    static void record(TraceEventType type, const void* arg)
+    {
+        record(type, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(arg)));
+    }
+    //调用方已经读过时钟(统计排队/执行时间)，直接用它的时间戳，不再读一次
+    static void record(TraceEventType type, std::chrono::steady_clock::time_point time, const void* arg, const char* name);
+    //取出所有线程缓冲区里的事件，按时间排序
+    static std::vector<TraceEvent> collect();
+    //把collect()的结果写到path，返回写了多少个事件，失败返回0
+    static size_t dump(const char* path);
+    //把collect()的结果按Chrome Trace Event格式写到path，返回写了多少个事件，失败返回0
+    static size_t dumpChrome(const char* path);
+    //把事件转成Chrome Trace Event格式的json写到fp，trace_dump离线转换也用这个
+    static void writeChrome(FILE* fp, const std::vector<TraceEvent>& events, const TraceNameTable& names);
+    static const char* eventName(uint32_t type);
+private:
+    static std::atomic_bool enabled_;
+};
+
+#ifdef THREADPOOL_TRACE
+#define TP_TRACE(type, arg) \
+    do { if (Trace::enabled()) Trace::record((type), (arg)); } while (0)
+#define TP_TRACE_AT(type, time, arg, name) \
+    do { if (Trace::enabled()) Trace::record((type), (time), (arg), (name)); } while (0)
+#else
+#define TP_TRACE(type, arg) do {} while (0)
+#define TP_TRACE_AT(type, time, arg, name) do {} while (0)
+#endif
+
+#endif //TRACE_H
@@ -0,0 +1,377 @@
+#include "bench_pool.h"
+#include "bench_latch.h"
+#include "histogram.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+/*
+仓库里四个线程池的对比：ThreadPool、ThreadPool_change(可变参submitTask)、Common_tools(threadpool_r3.hpp)、SEACAVE(thread.h)
+场景：
+1. empty     空任务吞吐量，一个线程连续提交
+2. latency   按固定速率提交，统计提交到开始执行的延迟
+3. fanout    每轮提交一批小任务再等全部完成(fan-out/fan-in)，延迟列是每轮的耗时
+4. forkjoin  任务在线程池里递归地提交两个子任务(二叉树)，不在工作线程里阻塞等待，否则固定线程数的池会死锁
+5. producers 多个线程同时提交空任务，测任务队列锁的竞争
+6. mixed     大小混合的任务：90%1us、9%50us、1%1ms，延迟列是提交到开始执行
+用法：bench [--threads n] [--scale x] [--pool 名字] [--scenario 名字] [--csv 文件] [--json 文件]
+结果写到bench.csv和bench.json(Common_tools的线程启动时会往stdout打日志，所以结果不写stdout)
+*/
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+struct BenchResult
+{
+    std::string pool;
+    std::string scenario;
+    int threads;
+    long long tasks;
+    double seconds;
+    double throughput; //每秒完成的任务数
+    double p50; //us，没有延迟统计的场景为-1
+    double p99;
+    double p999;
+};
+
+//忙等一段时间，模拟计算
+void spin(std::chrono::nanoseconds duration)
+{
+    auto end = Clock::now() + duration;
+    while (Clock::now() < end)
+    {
+    }
+}
+
+double seconds(Clock::time_point begin, Clock::time_point end)
+{
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+int64_t nanos(Clock::duration d)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+//把延迟(ns)填进结果的百分位列
+void fillPercentiles(BenchResult& result, const std::vector<int64_t>& samples)
+{
+    HistogramSnapshot histogram;
+    for (int64_t ns : samples)
+    {
+        histogram.record(ns < 0 ? 0 : static_cast<uint64_t>(ns));
+    }
+    result.p50 = histogram.percentile(50) / 1000.0;
+    result.p99 = histogram.percentile(99) / 1000.0;
+    result.p999 = histogram.percentile(99.9) / 1000.0;
+}
+
+void emptyThroughput(BenchPool& pool, BenchResult& result, long long n)
+{
+    Latch latch(n);
+    auto begin = Clock::now();
+    for (long long i = 0; i < n; i++)
+    {
+        pool.submit([&latch]() { latch.countDown(); });
+    }
+    latch.wait();
+    result.tasks = n;
+    result.seconds = seconds(begin, Clock::now());
+}
+
+void submitLatency(BenchPool& pool, BenchResult& result, long long n)
+{
+    const auto interval = std::chrono::microseconds(200); //5000个/s，远低于任何一个池的饱和点
+    std::vector<int64_t> samples(n);
+    Latch latch(n);
+    auto begin = Clock::now();
+    auto next = begin;
+    for (long long i = 0; i < n; i++)
+    {
+        std::this_thread::sleep_until(next);
+        next += interval;
+        auto submitTime = Clock::now();
+        pool.submit([&samples, &latch, i, submitTime]() {
+            samples[i] = nanos(Clock::now() - submitTime);
+            latch.countDown();
+        });
+    }
+    latch.wait();
+    result.tasks = n;
+    result.seconds = seconds(begin, Clock::now());
+    fillPercentiles(result, samples);
+}
+
+void fanOutFanIn(BenchPool& pool, BenchResult& result, long long rounds)
+{
+    const int width = 64;
+    std::vector<int64_t> samples(rounds);
+    auto begin = Clock::now();
+    for (long long r = 0; r < rounds; r++)
+    {
+        auto roundBegin = Clock::now();
+        Latch latch(width);
+        for (int i = 0; i < width; i++)
+        {
+            pool.submit([&latch]() {
+                spin(std::chrono::microseconds(1));
+                latch.countDown();
+            });
+        }
+        latch.wait();
+        samples[r] = nanos(Clock::now() - roundBegin);
+    }
+    result.tasks = rounds * width;
+    result.seconds = seconds(begin, Clock::now());
+    fillPercentiles(result, samples);
+}
+
+//深度为depth的二叉树，每个节点是一个任务，先提交两个子节点再结束
+void forkNode(BenchPool& pool, Latch& latch, int depth)
+{
+    if (depth > 0)
+    {
+        pool.submit([&pool, &latch, depth]() { forkNode(pool, latch, depth - 1); });
+        pool.submit([&pool, &latch, depth]() { forkNode(pool, latch, depth - 1); });
+    }
+    latch.countDown();
+}
+
+void forkJoin(BenchPool& pool, BenchResult& result, int depth)
+{
+    long long nodes = (2LL << depth) - 1;
+    Latch latch(nodes);
+    auto begin = Clock::now();
+    pool.submit([&pool, &latch, depth]() { forkNode(pool, latch, depth); });
+    latch.wait();
+    result.tasks = nodes;
+    result.seconds = seconds(begin, Clock::now());
+}
+
+void contendedProducers(BenchPool& pool, BenchResult& result, long long n)
+{
+    const int producers = 4;
+    long long perProducer = n / producers;
+    Latch latch(perProducer * producers);
+    std::atomic_int ready(0);
+    std::atomic_bool go(false);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++)
+    {
+        threads.emplace_back([&]() {
+            ready++;
+            while (!go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            for (long long i = 0; i < perProducer; i++)
+            {
+                pool.submit([&latch]() { latch.countDown(); });
+            }
+        });
+    }
+    while (ready.load() < producers)
+    {
+        std::this_thread::yield();
+    }
+    auto begin = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    latch.wait();
+    result.tasks = perProducer * producers;
+    result.seconds = seconds(begin, Clock::now());
+}
+
+void mixedSizes(BenchPool& pool, BenchResult& result, long long n)
+{
+    std::vector<int64_t> samples(n);
+    Latch latch(n);
+    auto begin = Clock::now();
+    for (long long i = 0; i < n; i++)
+    {
+        std::chrono::nanoseconds work = std::chrono::microseconds(1);
+        if (i % 100 == 0)
+        {
+            work = std::chrono::milliseconds(1);
+        }
+        else if (i % 10 == 0)
+        {
+            work = std::chrono::microseconds(50);
+        }
+        auto submitTime = Clock::now();
+        pool.submit([&samples, &latch, i, submitTime, work]() {
+            samples[i] = nanos(Clock::now() - submitTime);
+            spin(work);
+            latch.countDown();
+        });
+    }
+    latch.wait();
+    result.tasks = n;
+    result.seconds = seconds(begin, Clock::now());
+    fillPercentiles(result, samples);
+}
+
+struct PoolEntry
+{
+    const char* name;
+    BenchPoolFactory factory;
+};
+
+const char* SCENARIOS[] = {"empty", "latency", "fanout", "forkjoin", "producers", "mixed"};
+
+BenchResult runScenario(const PoolEntry& entry, const char* scenario, int threads, double scale)
+{
+    BenchResult result{entry.name, scenario, threads, 0, 0, 0, -1, -1, -1};
+    auto count = [scale](long long base) { return std::max(1LL, static_cast<long long>(base * scale)); };
+    //每个场景用一个新的线程池，构造和析构不计时
+    std::unique_ptr<BenchPool> pool = entry.factory(threads);
+    if (std::strcmp(scenario, "empty") == 0)
+    {
+        emptyThroughput(*pool, result, count(200000));
+    }
+    else if (std::strcmp(scenario, "latency") == 0)
+    {
+        submitLatency(*pool, result, count(5000));
+    }
+    else if (std::strcmp(scenario, "fanout") == 0)
+    {
+        fanOutFanIn(*pool, result, count(500));
+    }
+    else if (std::strcmp(scenario, "forkjoin") == 0)
+    {
+        int depth = 1;
+        while ((2LL << (depth + 1)) - 1 <= count(131071))
+        {
+            depth++;
+        }
+        forkJoin(*pool, result, depth);
+    }
+    else if (std::strcmp(scenario, "producers") == 0)
+    {
+        contendedProducers(*pool, result, count(200000));
+    }
+    else
+    {
+        mixedSizes(*pool, result, count(2000));
+    }
+    pool.reset();
+    result.throughput = result.seconds > 0 ? result.tasks / result.seconds : 0;
+    return result;
+}
+
+void writeCsv(const char* path, const std::vector<BenchResult>& results)
+{
+    FILE* fp = std::fopen(path, "w");
+    if (fp == nullptr)
+    {
+        std::perror(path);
+        return;
+    }
+    std::fprintf(fp, "pool,scenario,threads,tasks,seconds,throughput,p50_us,p99_us,p999_us\n");
+    for (const BenchResult& r : results)
+    {
+        std::fprintf(fp, "%s,%s,%d,%lld,%.6f,%.1f,%.3f,%.3f,%.3f\n", r.pool.c_str(), r.scenario.c_str(),
+            r.threads, r.tasks, r.seconds, r.throughput, r.p50, r.p99, r.p999);
+    }
+    std::fclose(fp);
+}
+
+void writeJson(const char* path, const std::vector<BenchResult>& results)
+{
+    FILE* fp = std::fopen(path, "w");
+    if (fp == nullptr)
+    {
+        std::perror(path);
+        return;
+    }
+    std::fprintf(fp, "[\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        std::fprintf(fp, "  {\"pool\":\"%s\",\"scenario\":\"%s\",\"threads\":%d,\"tasks\":%lld,\"seconds\":%.6f,"
+            "\"throughput\":%.1f,\"p50_us\":%.3f,\"p99_us\":%.3f,\"p999_us\":%.3f}%s\n",
+            r.pool.c_str(), r.scenario.c_str(), r.threads, r.tasks, r.seconds, r.throughput,
+            r.p50, r.p99, r.p999, i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(fp, "]\n");
+    std::fclose(fp);
+}
+}
+
+int main(int argc, char** argv)
+{
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    double scale = 1.0;
+    const char* poolFilter = nullptr;
+    const char* scenarioFilter = nullptr;
+    const char* csvPath = "bench.csv";
+    const char* jsonPath = "bench.json";
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--threads") == 0)
+        {
+            threads = std::atoi(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--scale") == 0)
+        {
+            scale = std::atof(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--pool") == 0)
+        {
+            poolFilter = argv[i + 1];
+        }
+        else if (std::strcmp(argv[i], "--scenario") == 0)
+        {
+            scenarioFilter = argv[i + 1];
+        }
+        else if (std::strcmp(argv[i], "--csv") == 0)
+        {
+            csvPath = argv[i + 1];
+        }
+        else if (std::strcmp(argv[i], "--json") == 0)
+        {
+            jsonPath = argv[i + 1];
+        }
+    }
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+    const PoolEntry pools[] = {
+        {"ThreadPool", makeTaskThreadPool},
+        {"ThreadPool_change", makeVariadicThreadPool},
+        {"Common_tools", makeR3ThreadPool},
+        {"SEACAVE", makeSeacaveThreadPool},
+    };
+    std::vector<BenchResult> results;
+    for (const char* scenario : SCENARIOS)
+    {
+        if (scenarioFilter != nullptr && std::strcmp(scenarioFilter, scenario) != 0)
+        {
+            continue;
+        }
+        for (const PoolEntry& entry : pools)
+        {
+            if (poolFilter != nullptr && std::strcmp(poolFilter, entry.name) != 0)
+            {
+                continue;
+            }
+            BenchResult r = runScenario(entry, scenario, threads, scale);
+            std::fprintf(stderr, "%-18s %-10s %10lld tasks %9.3fs %12.0f/s  p50 %9.2fus p99 %9.2fus p99.9 %9.2fus\n",
+                r.pool.c_str(), r.scenario.c_str(), r.tasks, r.seconds, r.throughput, r.p50, r.p99, r.p999);
+            results.push_back(r);
+        }
+    }
+    writeCsv(csvPath, results);
+    writeJson(jsonPath, results);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "threadpool.h"
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+/*
+cached模式两种线程数策略的对比：
+1. 原来的策略：任务数 > 空闲线程数就加线程，空闲60s才回收
+2. 自适应策略(setAdaptive)：爬山法按吞吐量加减线程
+分别跑CPU密集、IO密集、混合三种任务，输出吞吐量和结束时的线程数
+*/
+using Clock = std::chrono::steady_clock;
+
+enum class Workload
+{
+    CPU_BOUND, //每个任务算200us
+    IO_BOUND, //每个任务睡5ms，模拟等待IO
+    MIXED, //每4个任务里1个IO、3个CPU
+};
+
+class BenchTask : public Task
+{
+public:
+    BenchTask(bool io) : io_(io) {}
+    Any run()
+    {
+        if (io_)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            return 0;
+        }
+        //忙等200us，模拟计算
+        auto end = Clock::now() + std::chrono::microseconds(200);
+        unsigned long long n = 0;
+        while (Clock::now() < end)
+        {
+            n++;
+        }
+        return static_cast<int>(n & 1);
+    }
+private:
+    bool io_;
+};
+
+const char* workloadName(Workload w)
+{
+    switch (w)
+    {
+    case Workload::CPU_BOUND: return "cpu";
+    case Workload::IO_BOUND: return "io";
+    case Workload::MIXED: return "mixed";
+    }
+    return "";
+}
+
+//提交taskCount个任务并等全部完成，返回每秒完成的任务数
+double runOnce(Workload w, bool adaptive, int taskCount, int& threadsAtEnd)
+{
+    ThreadPool pool;
+    pool.setMode(PoolMode::MODE_CACHED);
+    pool.setAdaptive(adaptive);
+    pool.start(std::max(1u, std::thread::hardware_concurrency()));
+
+    auto begin = Clock::now();
+    std::vector<Result> results;
+    results.reserve(taskCount);
+    for (int i = 0; i < taskCount; i++)
+    {
+        bool io = w == Workload::IO_BOUND || (w == Workload::MIXED && i % 4 == 0);
+        results.emplace_back(pool.submitTask(std::make_shared<BenchTask>(io)));
+    }
+    for (auto& res : results)
+    {
+        res.get();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    threadsAtEnd = pool.getCurThreadSize();
+    return taskCount / seconds;
+}
+
+int main(int argc, char** argv)
+{
+    int taskCount = argc > 1 ? std::stoi(argv[1]) : 5000;
+    std::cout << "workload,policy,tasks,throughput(tasks/s),threads_at_end" << std::endl;
+    for (Workload w : {Workload::CPU_BOUND, Workload::IO_BOUND, Workload::MIXED})
+    {
+        for (bool adaptive : {false, true})
+        {
+            int threads = 0;
+            double tput = runOnce(w, adaptive, taskCount, threads);
+            std::cout << workloadName(w) << "," << (adaptive ? "hill-climbing" : "grow-on-backlog")
+                << "," << taskCount << "," << tput << "," << threads << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include "threadpool.h"
+#include "histogram.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+/*
+任务队列满时的几种RejectPolicy在2倍过载下的表现
+1. 先闭环测出线程池的饱和吞吐量
+2. 每种策略用一个新的有界队列线程池，生产者开环按 饱和吞吐量 × --overload 的速率提交 --duration 时间，
+   落后了(被BLOCK卡住、CALLER_RUNS自己在执行任务)就接着交下一个，到时间为止，submit_rate能看出生产者被拖慢了多少
+3. 延迟 = 任务执行完的时间 - 计划到达时间，被拒绝和被丢掉的任务不算
+任务是sleep而不是忙等：容量就是 线程数 / 任务时长，和机器有几个核无关，生产者也不会和工作线程抢CPU
+用法：bench_backpressure [--threads n] [--work us] [--queue n] [--duration ms] [--overload x]
+结果以csv打印到stdout
+*/
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+uint64_t nanos(Clock::duration d)
+{
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    return ns < 0 ? 0 : static_cast<uint64_t>(ns);
+}
+
+class SleepTask : public Task
+{
+public:
+    SleepTask(std::chrono::microseconds work, Clock::time_point intended, LatencyHistogram& latency)
+        : work_(work)
+        , intended_(intended)
+        , latency_(latency)
+    {}
+    Any run()
+    {
+        std::this_thread::sleep_for(work_);
+        latency_.recordConcurrent(nanos(Clock::now() - intended_));
+        return 0;
+    }
+private:
+    std::chrono::microseconds work_;
+    Clock::time_point intended_;
+    LatencyHistogram& latency_;
+};
+
+//闭环：一次提交n个任务(队列不设上限)，等全部完成，返回每秒完成的任务数
+double saturation(int threads, std::chrono::microseconds work, int n)
+{
+    ThreadPool pool;
+    pool.start(threads);
+    LatencyHistogram latency;
+    std::vector<Result> results;
+    results.reserve(n);
+    auto begin = Clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        results.push_back(pool.submitTask(std::make_shared<SleepTask>(work, Clock::now(), latency)));
+    }
+    for (Result& result : results)
+    {
+        result.get();
+    }
+    return n / std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+const char* policyName(RejectPolicy policy)
+{
+    switch (policy)
+    {
+    case RejectPolicy::BLOCK: return "BLOCK";
+    case RejectPolicy::BLOCK_TIMEOUT: return "BLOCK_TIMEOUT";
+    case RejectPolicy::FAIL_FAST: return "FAIL_FAST";
+    case RejectPolicy::CALLER_RUNS: return "CALLER_RUNS";
+    case RejectPolicy::DROP_OLDEST: return "DROP_OLDEST";
+    }
+    return "?";
+}
+}
+
+int main(int argc, char** argv)
+{
+    int threads = 4;
+    auto work = std::chrono::microseconds(1000);
+    int queue = 64;
+    auto duration = std::chrono::milliseconds(2000);
+    double overload = 2.0;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--threads") == 0)
+        {
+            threads = std::atoi(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--work") == 0)
+        {
+            work = std::chrono::microseconds(std::atoi(argv[i + 1]));
+        }
+        else if (std::strcmp(argv[i], "--queue") == 0)
+        {
+            queue = std::atoi(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--duration") == 0)
+        {
+            duration = std::chrono::milliseconds(std::atoi(argv[i + 1]));
+        }
+        else if (std::strcmp(argv[i], "--overload") == 0)
+        {
+            overload = std::atof(argv[i + 1]);
+        }
+    }
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+    double capacity = saturation(threads, work, threads * 500);
+    double rate = capacity * overload;
+    auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+    std::fprintf(stderr, "capacity %.0f tasks/s, offered %.0f tasks/s\n", capacity, rate);
+
+    const RejectPolicy policies[] = {
+        RejectPolicy::BLOCK,
+        RejectPolicy::BLOCK_TIMEOUT,
+        RejectPolicy::FAIL_FAST,
+        RejectPolicy::CALLER_RUNS,
+        RejectPolicy::DROP_OLDEST,
+    };
+    std::printf("policy,offered_rate,submit_rate,goodput,submitted,completed,rejected,dropped,caller_runs,blocked,"
+        "p50_us,p99_us,max_us\n");
+    for (RejectPolicy policy : policies)
+    {
+        ThreadPool pool;
+        pool.setTaskQueMaxThreshold(queue);
+        //超时取几个任务时长，比默认的1s短得多，过载时才会真的超时
+        pool.setRejectPolicy(policy, std::chrono::duration_cast<std::chrono::milliseconds>(work * 4));
+        pool.start(threads);
+        LatencyHistogram latency;
+        std::vector<Result> results;
+        long long submitted = 0;
+        auto begin = Clock::now();
+        auto end = begin + duration;
+        for (long long i = 0;; i++)
+        {
+            auto intended = begin + interval * i;
+            if (intended >= end)
+            {
+                break;
+            }
+            if (Clock::now() < intended)
+            {
+                std::this_thread::sleep_until(intended);
+            }
+            else if (Clock::now() >= end)
+            {
+                break;
+            }
+            results.push_back(pool.submitTask(std::make_shared<SleepTask>(work, intended, latency)));
+            submitted++;
+        }
+        double submitSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        for (Result& result : results)
+        {
+            result.get();
+        }
+        double totalSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        PoolStats stats = pool.stats();
+        uint64_t completed = stats.total.tasksExecuted + stats.callerRuns;
+        HistogramSnapshot snapshot;
+        snapshot.add(latency);
+        std::printf("%s,%.0f,%.0f,%.0f,%lld,%llu,%llu,%llu,%llu,%llu,%.1f,%.1f,%.1f\n", policyName(policy), rate,
+            submitted / submitSeconds, completed / totalSeconds, submitted,
+            static_cast<unsigned long long>(completed), static_cast<unsigned long long>(stats.rejected),
+            static_cast<unsigned long long>(stats.dropped), static_cast<unsigned long long>(stats.callerRuns),
+            static_cast<unsigned long long>(stats.blocked), snapshot.percentile(50) / 1000.0,
+            snapshot.percentile(99) / 1000.0, snapshot.max() / 1000.0);
+        std::fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "bench_pool.h"
+#include "bench_latch.h"
+#include "histogram.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+/*
+开环的提交到开始执行延迟测试：ThreadPool::submitTask和ThreadPool_change的可变参submitTask
+1. 先用一次性提交一大批任务的方式测出饱和吞吐量
+2. 按饱和吞吐量的10%~110%设定到达速率，第i个任务的计划到达时间是begin + i * 间隔，
+   生产者按计划提交，落后了(submitTask阻塞、被调度出去)就立刻补交，不会因为系统慢而少发任务
+3. 延迟 = 任务开始执行的时间 - 计划到达时间，这样生产者自己被卡住的时间也算进延迟(协调遗漏修正，coordinated omission)；
+   同时记一份 开始执行 - 实际提交 的未修正延迟，对比两者能看出修正前的p99.9低估了多少
+用法：bench_latency [--threads n] [--work us] [--duration ms]
+结果以csv打印到stdout
+*/
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+void spin(std::chrono::nanoseconds duration)
+{
+    auto end = Clock::now() + duration;
+    while (Clock::now() < end)
+    {
+    }
+}
+
+uint64_t nanos(Clock::duration d)
+{
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    return ns < 0 ? 0 : static_cast<uint64_t>(ns);
+}
+
+//闭环：一次提交n个任务，等全部完成，返回每秒完成的任务数
+double saturation(BenchPool& pool, std::chrono::nanoseconds work, long long n)
+{
+    Latch latch(n);
+    auto begin = Clock::now();
+    for (long long i = 0; i < n; i++)
+    {
+        pool.submit([&latch, work]() {
+            spin(work);
+            latch.countDown();
+        });
+    }
+    latch.wait();
+    return n / std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+//等到when，离得远就睡，近了就让出CPU(只有一个核时忙等会饿死工作线程)
+void waitUntil(Clock::time_point when)
+{
+    const auto sleepThreshold = std::chrono::microseconds(200);
+    for (;;)
+    {
+        auto now = Clock::now();
+        if (now >= when)
+        {
+            return;
+        }
+        if (when - now > sleepThreshold)
+        {
+            std::this_thread::sleep_until(when - sleepThreshold);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+struct StepResult
+{
+    long long tasks;
+    double achievedRate;
+};
+
+//开环按rate(个/s)提交duration时间
+StepResult openLoop(BenchPool& pool, std::chrono::nanoseconds work, double rate, std::chrono::milliseconds duration,
+    LatencyHistogram& corrected, LatencyHistogram& raw)
+{
+    auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+    long long n = static_cast<long long>(rate * std::chrono::duration<double>(duration).count());
+    if (n < 1)
+    {
+        n = 1;
+    }
+    Latch latch(n);
+    auto begin = Clock::now();
+    for (long long i = 0; i < n; i++)
+    {
+        auto intended = begin + interval * i;
+        waitUntil(intended);
+        auto submitTime = Clock::now();
+        pool.submit([&latch, &corrected, &raw, work, intended, submitTime]() {
+            auto start = Clock::now();
+            corrected.recordConcurrent(nanos(start - intended));
+            raw.recordConcurrent(nanos(start - submitTime));
+            spin(work);
+            latch.countDown();
+        });
+    }
+    latch.wait();
+    return StepResult{n, n / std::chrono::duration<double>(Clock::now() - begin).count()};
+}
+}
+
+int main(int argc, char** argv)
+{
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    auto work = std::chrono::microseconds(10);
+    auto duration = std::chrono::milliseconds(1000);
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--threads") == 0)
+        {
+            threads = std::atoi(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--work") == 0)
+        {
+            work = std::chrono::microseconds(std::atoi(argv[i + 1]));
+        }
+        else if (std::strcmp(argv[i], "--duration") == 0)
+        {
+            duration = std::chrono::milliseconds(std::atoi(argv[i + 1]));
+        }
+    }
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+    struct PoolEntry
+    {
+        const char* name;
+        BenchPoolFactory factory;
+    };
+    const PoolEntry pools[] = {
+        {"ThreadPool", makeTaskThreadPool},
+        {"ThreadPool_change", makeVariadicThreadPool},
+    };
+    std::printf("pool,load_pct,target_rate,achieved_rate,tasks,p50_us,p90_us,p99_us,p999_us,max_us,raw_p99_us,raw_p999_us\n");
+    for (const PoolEntry& entry : pools)
+    {
+        double saturated = 0;
+        {
+            std::unique_ptr<BenchPool> pool = entry.factory(threads);
+            //预热一次再测
+            saturation(*pool, work, 10000);
+            saturated = saturation(*pool, work, 50000);
+        }
+        std::fprintf(stderr, "%s: saturation %.0f tasks/s\n", entry.name, saturated);
+        for (int load = 10; load <= 110; load += 10)
+        {
+            //每一档用新的线程池，上一档堆积的任务不影响这一档
+            std::unique_ptr<BenchPool> pool = entry.factory(threads);
+            LatencyHistogram corrected;
+            LatencyHistogram raw;
+            double rate = saturated * load / 100.0;
+            StepResult step = openLoop(*pool, work, rate, duration, corrected, raw);
+            HistogramSnapshot c;
+            HistogramSnapshot r;
+            c.add(corrected);
+            r.add(raw);
+            std::printf("%s,%d,%.0f,%.0f,%lld,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", entry.name, load, rate,
+                step.achievedRate, step.tasks, c.percentile(50) / 1000.0, c.percentile(90) / 1000.0,
+                c.percentile(99) / 1000.0, c.percentile(99.9) / 1000.0, c.max() / 1000.0,
+                r.percentile(99) / 1000.0, r.percentile(99.9) / 1000.0);
+            std::fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include "bench_pool.h"
+#include <iostream> //threadpool_r3.hpp用了std::cout却没有包含iostream
+#include "threadpool_r3.hpp"
+
+namespace
+{
+class R3ThreadPool : public BenchPool
+{
+public:
+    //不改调度优先级；它不管参数都会把线程绑到CPU上，这是它本来的行为，照原样测
+    R3ThreadPool(int threads) : pool_(threads, false, false) {}
+    const char* name() const { return "Common_tools"; }
+    void submit(std::function<void()> task)
+    {
+        pool_.commit_task(std::move(task));
+    }
+private:
+    Common_tools::ThreadPool pool_;
+};
+}
+
+std::unique_ptr<BenchPool> makeR3ThreadPool(int threads)
+{
+    return std::make_unique<R3ThreadPool>(threads);
+}
@@ -0,0 +1,96 @@
+#include "bench_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+//thread.h原来依赖SEACAVE库的导出宏和CList容器，这里补上最小的替代
+#define GENERAL_API
+#define STCALL
+template<typename TYPE, typename IDX>
+class SeacaveThreads
+{
+public:
+    SeacaveThreads() {}
+    SeacaveThreads(IDX size) : items_(size) {}
+    void resize(IDX size) { items_.resize(size); }
+    void Release() { items_.clear(); }
+    bool empty() const { return items_.empty(); }
+    IDX size() const { return static_cast<IDX>(items_.size()); }
+    const TYPE* cbegin() const { return items_.data(); }
+    const TYPE* cend() const { return items_.data() + items_.size(); }
+    const TYPE* begin() const { return cbegin(); }
+    const TYPE* end() const { return cend(); }
+    TYPE* begin() { return items_.data(); }
+    TYPE* end() { return items_.data() + items_.size(); }
+    const TYPE& operator[](IDX index) const { return items_[index]; }
+    TYPE& operator[](IDX index) { return items_[index]; }
+private:
+    std::vector<TYPE> items_;
+};
+#define CLISTDEFIDX(TYPE, IDX) SeacaveThreads<TYPE, IDX>
+#include "thread.h"
+
+namespace
+{
+//SEACAVE::ThreadPool只是n个跑同一个函数的线程，任务队列用最普通的一把锁加一个条件变量
+class SeacaveThreadPool : public BenchPool
+{
+public:
+    SeacaveThreadPool(int threads)
+        : threads_(threads)
+        , stop_(false)
+    {
+        threads_.start(&SeacaveThreadPool::worker, this);
+    }
+    ~SeacaveThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        threads_.join();
+    }
+    const char* name() const { return "SEACAVE"; }
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            tasks_.emplace(std::move(task));
+        }
+        cond_.notify_one();
+    }
+private:
+    static void* worker(void* arg)
+    {
+        SeacaveThreadPool* self = static_cast<SeacaveThreadPool*>(arg);
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(self->mtx_);
+                self->cond_.wait(lock, [self]() { return self->stop_ || !self->tasks_.empty(); });
+                if (self->tasks_.empty())
+                {
+                    return nullptr;
+                }
+                task = std::move(self->tasks_.front());
+                self->tasks_.pop();
+            }
+            task();
+        }
+    }
+
+    SEACAVE::ThreadPool threads_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::queue<std::function<void()>> tasks_;
+    bool stop_;
+};
+}
+
+std::unique_ptr<BenchPool> makeSeacaveThreadPool(int threads)
+{
+    return std::make_unique<SeacaveThreadPool>(threads);
+}
@@ -0,0 +1,41 @@
+#include "bench_pool.h"
+#include "threadpool.h"
+
+namespace
+{
+class FunctionTask : public Task
+{
+public:
+    FunctionTask(std::function<void()> func) : func_(std::move(func)) {}
+    Any run()
+    {
+        func_();
+        return 0;
+    }
+private:
+    std::function<void()> func_;
+};
+
+class TaskThreadPool : public BenchPool
+{
+public:
+    TaskThreadPool(int threads)
+    {
+        pool_.setMode(PoolMode::MODE_FIXED);
+        pool_.start(threads);
+    }
+    const char* name() const { return "ThreadPool"; }
+    void submit(std::function<void()> task)
+    {
+        //不接收返回值，Result临时对象直接析构
+        pool_.submitTask(std::make_shared<FunctionTask>(std::move(task)));
+    }
+private:
+    ThreadPool pool_;
+};
+}
+
+std::unique_ptr<BenchPool> makeTaskThreadPool(int threads)
+{
+    return std::make_unique<TaskThreadPool>(threads);
+}
@@ -0,0 +1,47 @@
+#include "bench_pool.h"
+//ThreadPool_change的头文件和本项目的threadpool.h用的是同一个include guard，类名也一样，
+//先把它用到的标准库头文件包含进来，再把它整个包在variadic命名空间里，链接时不会和src/threadpool.cpp冲突
+#include <vector>
+#include <thread>
+#include <queue>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <unordered_map>
+#include <future>
+#include <climits>
+#include <chrono>
+#include <stdexcept>
+#include <semaphore.h>
+namespace variadic
+{
+#include "../../ThreadPool_change/include/threadpool.h"
+}
+
+namespace
+{
+class VariadicThreadPool : public BenchPool
+{
+public:
+    VariadicThreadPool(int threads)
+    {
+        pool_.setMode(variadic::PoolMode::MODE_FIXED);
+        pool_.start(threads);
+    }
+    const char* name() const { return "ThreadPool_change"; }
+    void submit(std::function<void()> task)
+    {
+        pool_.submitTask(std::move(task));
+    }
+private:
+    variadic::ThreadPool pool_;
+};
+}
+
+std::unique_ptr<BenchPool> makeVariadicThreadPool(int threads)
+{
+    return std::make_unique<VariadicThreadPool>(threads);
+}
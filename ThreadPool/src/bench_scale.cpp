@@ -0,0 +1,178 @@
+#include "threadpool.h"
+#include "bench_latch.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+/*
+ThreadPool的扩展性测试：线程数(1..2×核数) × 任务粒度(50ns..10ms) × 生产者数 × fixed/cached
+每一格提交一批忙等任务，总的计算量大约是 --budget ms × 线程数，输出：
+throughput  每秒完成的任务数
+speedup     相对同一行(模式、粒度、生产者数相同)1个线程的吞吐量
+efficiency  speedup / 线程数，1表示线性扩展
+lock_*      taskQueMtx_被拿到的次数和其中有竞争(try_lock失败)的次数，来自ThreadPool::stats()
+cached模式从1个线程起步，上限是这一格的线程数，测的是它边跑边加线程的效果
+用法：bench_scale [--max-threads n] [--budget ms]，结果以csv打印到stdout
+*/
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+//固定次数的循环，不能用"忙等到某个时间点"：线程数超过核数时，被抢占的时间也会算成完成了的工作
+volatile uint64_t spinSink;
+void spinLoop(uint64_t iterations)
+{
+    uint64_t x = 0;
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        x += i ^ (x >> 3);
+    }
+    spinSink = x;
+}
+
+//测出1ns大约要循环多少次
+double calibrate()
+{
+    const uint64_t iterations = 50000000;
+    auto begin = Clock::now();
+    spinLoop(iterations);
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+    return iterations / ns;
+}
+
+class SpinTask : public Task
+{
+public:
+    SpinTask(uint64_t iterations, Latch& latch) : iterations_(iterations), latch_(latch) {}
+    Any run()
+    {
+        spinLoop(iterations_);
+        latch_.countDown();
+        return 0;
+    }
+private:
+    uint64_t iterations_;
+    Latch& latch_;
+};
+
+struct Cell
+{
+    long long tasks;
+    double seconds;
+    uint64_t lockAcquired;
+    uint64_t lockContended;
+};
+
+Cell runCell(PoolMode mode, int threads, int producers, std::chrono::nanoseconds work, std::chrono::milliseconds budget,
+    double iterationsPerNs)
+{
+    uint64_t iterations = static_cast<uint64_t>(work.count() * iterationsPerNs);
+    const long long minTasks = 64;
+    const long long maxTasks = 200000;
+    long long n = static_cast<long long>(std::chrono::duration<double>(budget).count() * threads
+        / std::chrono::duration<double>(work).count());
+    n = std::max(minTasks, std::min(maxTasks, n));
+    long long perProducer = (n + producers - 1) / producers;
+    n = perProducer * producers;
+
+    ThreadPool pool;
+    pool.setMode(mode);
+    if (mode == PoolMode::MODE_CACHED)
+    {
+        pool.setThreadSizeThreshold(threads);
+        pool.start(1);
+    }
+    else
+    {
+        pool.start(threads);
+    }
+    Latch latch(n);
+    PoolStats before = pool.stats();
+    auto begin = Clock::now();
+    std::vector<std::thread> submitters;
+    for (int p = 0; p < producers; p++)
+    {
+        submitters.emplace_back([&]() {
+            for (long long i = 0; i < perProducer; i++)
+            {
+                pool.submitTask(std::make_shared<SpinTask>(iterations, latch));
+            }
+        });
+    }
+    for (auto& t : submitters)
+    {
+        t.join();
+    }
+    latch.wait();
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    PoolStats after = pool.stats();
+    return Cell{n, seconds, after.lockAcquired - before.lockAcquired, after.lockContended - before.lockContended};
+}
+}
+
+int main(int argc, char** argv)
+{
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    int maxThreads = 2 * std::max(1, cores);
+    auto budget = std::chrono::milliseconds(200);
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--max-threads") == 0)
+        {
+            maxThreads = std::atoi(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--budget") == 0)
+        {
+            budget = std::chrono::milliseconds(std::atoi(argv[i + 1]));
+        }
+    }
+    double iterationsPerNs = calibrate();
+    std::vector<int> threadCounts;
+    for (int t = 1; t < maxThreads; t *= 2)
+    {
+        threadCounts.push_back(t);
+    }
+    threadCounts.push_back(maxThreads);
+    const std::chrono::nanoseconds works[] = {
+        std::chrono::nanoseconds(50), std::chrono::microseconds(1), std::chrono::microseconds(10),
+        std::chrono::microseconds(100), std::chrono::milliseconds(1), std::chrono::milliseconds(10)};
+    const int producerCounts[] = {1, 4};
+    const PoolMode modes[] = {PoolMode::MODE_FIXED, PoolMode::MODE_CACHED};
+
+    std::printf("mode,threads,producers,task_ns,tasks,seconds,throughput,speedup,efficiency,lock_acquired,lock_contended,contended_pct\n");
+    for (PoolMode mode : modes)
+    {
+        for (auto work : works)
+        {
+            for (int producers : producerCounts)
+            {
+                double baseline = 0;
+                for (int threads : threadCounts)
+                {
+                    Cell cell = runCell(mode, threads, producers, work, budget, iterationsPerNs);
+                    double throughput = cell.tasks / cell.seconds;
+                    if (threads == threadCounts.front())
+                    {
+                        baseline = throughput * threadCounts.front();
+                    }
+                    double speedup = throughput / (baseline / threadCounts.front());
+                    std::printf("%s,%d,%d,%lld,%lld,%.4f,%.0f,%.2f,%.2f,%llu,%llu,%.1f\n",
+                        mode == PoolMode::MODE_FIXED ? "fixed" : "cached", threads, producers,
+                        static_cast<long long>(work.count()), cell.tasks, cell.seconds, throughput, speedup,
+                        speedup / threads, static_cast<unsigned long long>(cell.lockAcquired),
+                        static_cast<unsigned long long>(cell.lockContended),
+                        cell.lockAcquired > 0 ? 100.0 * cell.lockContended / cell.lockAcquired : 0.0);
+                    std::fflush(stdout);
+                }
+            }
+        }
+    }
+    return 0;
+}
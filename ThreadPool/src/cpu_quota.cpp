@@ -0,0 +1,174 @@
+#include "cpu_quota.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <sched.h>
+
+namespace
+{
+const char* CGROUP_ROOT = "/sys/fs/cgroup";
+
+//从/proc/self/cgroup中找到controller所在的cgroup路径
+//v2只有一行"0::/path"(controller传空串)，v1每行为"id:cpu,cpuacct:/path"
+bool cgroupPath(const std::string& controller, std::string& path)
+{
+    std::ifstream in("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(in, line))
+    {
+        auto p1 = line.find(':');
+        auto p2 = line.find(':', p1 + 1);
+        if (p1 == std::string::npos || p2 == std::string::npos)
+        {
+            continue;
+        }
+        std::string controllers = line.substr(p1 + 1, p2 - p1 - 1);
+        if (controller.empty())
+        {
+            if (controllers.empty())
+            {
+                path = line.substr(p2 + 1);
+                return true;
+            }
+            continue;
+        }
+        std::stringstream ss(controllers);
+        std::string c;
+        while (std::getline(ss, c, ','))
+        {
+            if (c == controller)
+            {
+                path = line.substr(p2 + 1);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//v2: cpu.max内容为"max 100000"(无限制)或"200000 100000"
+//返回false表示文件不存在，limit = 0表示这一级没有限制
+bool readCpuMax(const std::string& dir, double& limit)
+{
+    std::ifstream in(dir + "/cpu.max");
+    if (!in)
+    {
+        return false;
+    }
+    std::string quota;
+    long period = 0;
+    limit = 0;
+    if ((in >> quota >> period) && quota != "max" && period > 0)
+    {
+        limit = std::stod(quota) / period;
+    }
+    return true;
+}
+
+//v1: cpu.cfs_quota_us为-1表示无限制
+bool readCfsQuota(const std::string& dir, double& limit)
+{
+    std::ifstream q(dir + "/cpu.cfs_quota_us");
+    std::ifstream p(dir + "/cpu.cfs_period_us");
+    if (!q || !p)
+    {
+        return false;
+    }
+    long quota = 0;
+    long period = 0;
+    limit = 0;
+    if ((q >> quota) && (p >> period) && quota > 0 && period > 0)
+    {
+        limit = static_cast<double>(quota) / period;
+    }
+    return true;
+}
+
+//从cgroup路径一路往上走到挂载点，取最严格的限制(父cgroup的配额同样会限流子cgroup)
+double walkUp(const std::string& mount, std::string path, bool (*reader)(const std::string&, double&))
+{
+    //容器里cgroup namespace可能让路径和挂载点对不上，走到最后总会读到挂载点本身
+    double result = 0;
+    for (;;)
+    {
+        double limit = 0;
+        if (reader(mount + path, limit) && limit > 0 && (result == 0 || limit < result))
+        {
+            result = limit;
+        }
+        if (path.empty() || path == "/")
+        {
+            break;
+        }
+        auto pos = path.find_last_of('/');
+        path = (pos == 0 || pos == std::string::npos) ? "" : path.substr(0, pos);
+    }
+    return result;
+}
+}
+
+double CpuQuota::cgroupCpuLimit()
+{
+    std::string path;
+    //cgroup v2(纯v2挂在/sys/fs/cgroup，hybrid模式挂在/sys/fs/cgroup/unified)
+    if (cgroupPath("", path))
+    {
+        const std::string mounts[] = {CGROUP_ROOT, std::string(CGROUP_ROOT) + "/unified"};
+        for (const auto& mount : mounts)
+        {
+            std::ifstream controllers(mount + "/cgroup.controllers");
+            if (controllers)
+            {
+                double limit = walkUp(mount, path, readCpuMax);
+                if (limit > 0)
+                {
+                    return limit;
+                }
+            }
+        }
+    }
+    //cgroup v1
+    if (cgroupPath("cpu", path))
+    {
+        const std::string mounts[] = {std::string(CGROUP_ROOT) + "/cpu", std::string(CGROUP_ROOT) + "/cpu,cpuacct"};
+        for (const auto& mount : mounts)
+        {
+            double limit = walkUp(mount, path, readCfsQuota);
+            if (limit > 0)
+            {
+                return limit;
+            }
+        }
+    }
+    return 0;
+}
+
+int CpuQuota::affinityCpuCount()
+{
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (sched_getaffinity(0, sizeof(cpuset), &cpuset) == 0)
+    {
+        int count = CPU_COUNT(&cpuset);
+        if (count > 0)
+        {
+            return count;
+        }
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+int CpuQuota::effectiveCpuCount()
+{
+    int cpus = affinityCpuCount();
+    double limit = cgroupCpuLimit();
+    if (limit > 0)
+    {
+        //向下取整：1.5个核的配额开2个CPU密集的线程，每个周期都会被CFS限流；不到1个核也至少1个线程
+        cpus = std::min(cpus, static_cast<int>(std::floor(limit)));
+    }
+    return std::max(1, cpus);
+}
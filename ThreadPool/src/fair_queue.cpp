@@ -0,0 +1,239 @@
+#include "fair_queue.h"
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+//每一份权重每轮拿到的配额：太大一个租户会连续占着线程很久，太小要多转几轮
+const int64_t TENANT_QUANTUM = 100000; //100us
+}
+
+FairTaskQueue::FairTaskQueue()
+    : size_(0)
+    , seq_(0)
+{
+    addTenant("default", 1);
+}
+
+int FairTaskQueue::addTenant(const std::string& name, int weight)
+{
+    weight = std::max(weight, 1);
+    for (size_t i = 0; i < tenants_.size(); i++)
+    {
+        if (tenants_[i].name == name)
+        {
+            tenants_[i].weight = weight;
+            return static_cast<int>(i);
+        }
+    }
+    Tenant tenant;
+    tenant.name = name;
+    tenant.weight = weight;
+    tenant.deficit = 0;
+    tenant.avgCost = 0;
+    tenant.visited = false;
+    tenant.active = false;
+    tenant.executed = 0;
+    tenant.runTime = 0;
+    tenants_.push_back(std::move(tenant));
+    return static_cast<int>(tenants_.size() - 1);
+}
+
+bool FairTaskQueue::setWeight(int tenant, int weight)
+{
+    if (tenant < 0 || tenant >= static_cast<int>(tenants_.size()))
+    {
+        return false;
+    }
+    tenants_[tenant].weight = std::max(weight, 1);
+    return true;
+}
+
+void FairTaskQueue::push(std::shared_ptr<Task> task, int tenant)
+{
+    if (tenant < 0 || tenant >= static_cast<int>(tenants_.size()))
+    {
+        tenant = DEFAULT_TENANT;
+    }
+    Tenant& t = tenants_[tenant];
+    t.tasks.push_back(Entry{std::move(task), seq_++});
+    size_++;
+    if (!t.active)
+    {
+        t.active = true;
+        active_.push_back(tenant);
+    }
+}
+
+std::shared_ptr<Task> FairTaskQueue::pop(int& tenant, int64_t& charged)
+{
+    if (active_.empty())
+    {
+        return nullptr;
+    }
+    //只有一个租户在排队，没有谁需要公平，也不让它在独占期间欠下的配额影响以后
+    if (active_.size() == 1)
+    {
+        tenants_[active_.front()].deficit = 0;
+    }
+    else
+    {
+        //轮到的租户先加一份配额，配额用完(<=0)就排到最后，下一个租户接着来
+        //上一个任务执行得特别久的租户欠得多，要多轮几次才能再拿到
+        catchUp();
+        for (;;)
+        {
+            Tenant& t = tenants_[active_.front()];
+            if (!t.visited)
+            {
+                t.deficit += TENANT_QUANTUM * t.weight;
+                t.visited = true;
+            }
+            if (t.deficit > 0)
+            {
+                break;
+            }
+            t.visited = false;
+            active_.push_back(active_.front());
+            active_.pop_front();
+        }
+    }
+    tenant = active_.front();
+    Tenant& t = tenants_[tenant];
+    std::shared_ptr<Task> task = std::move(t.tasks.front().task);
+    t.tasks.pop_front();
+    size_--;
+    charged = t.avgCost;
+    t.deficit -= charged;
+    if (t.tasks.empty())
+    {
+        active_.pop_front();
+        deactivate(tenant);
+    }
+    return task;
+}
+
+std::shared_ptr<Task> FairTaskQueue::popOldest()
+{
+    if (active_.empty())
+    {
+        return nullptr;
+    }
+    int oldest = active_.front();
+    for (int tenant : active_)
+    {
+        if (tenants_[tenant].tasks.front().seq < tenants_[oldest].tasks.front().seq)
+        {
+            oldest = tenant;
+        }
+    }
+    Tenant& t = tenants_[oldest];
+    std::shared_ptr<Task> task = std::move(t.tasks.front().task);
+    t.tasks.pop_front();
+    size_--;
+    if (t.tasks.empty())
+    {
+        active_.erase(std::find(active_.begin(), active_.end(), oldest));
+        deactivate(oldest);
+    }
+    return task;
+}
+
+bool FairTaskQueue::remove(const Task* task, int& tenant)
+{
+    if (tenant < 0 || tenant >= static_cast<int>(tenants_.size()))
+    {
+        tenant = DEFAULT_TENANT;
+    }
+    Tenant& t = tenants_[tenant];
+    //提交完马上get()的任务一般排在后面，从队尾往前找
+    auto it = std::find_if(t.tasks.rbegin(), t.tasks.rend(),
+        [&](const Entry& entry)->bool { return entry.task.get() == task; });
+    if (it == t.tasks.rend())
+    {
+        return false;
+    }
+    t.tasks.erase(std::next(it).base());
+    size_--;
+    if (t.tasks.empty())
+    {
+        active_.erase(std::find(active_.begin(), active_.end(), tenant));
+        deactivate(tenant);
+    }
+    return true;
+}
+
+void FairTaskQueue::charge(int tenant, int64_t charged, int64_t actual)
+{
+    Tenant& t = tenants_[tenant];
+    t.deficit -= actual - charged;
+    t.executed++;
+    t.runTime += actual;
+    //指数平均，1/8的新样本
+    t.avgCost = t.avgCost == 0 ? actual : t.avgCost + (actual - t.avgCost) / 8;
+}
+
+void FairTaskQueue::refund(int tenant, int64_t charged)
+{
+    Tenant& t = tenants_[tenant];
+    t.deficit += charged;
+    //已经不在轮转里的租户不能攒配额，和deactivate一样
+    if (!t.active)
+    {
+        t.deficit = std::min<int64_t>(t.deficit, 0);
+    }
+}
+
+void FairTaskQueue::catchUp()
+{
+    //这一轮加完配额还有租户是正的，轮转一遍之内就能找到，不用跳
+    for (int tenant : active_)
+    {
+        const Tenant& t = tenants_[tenant];
+        if (t.deficit + (t.visited ? 0 : TENANT_QUANTUM * t.weight) > 0)
+        {
+            return;
+        }
+    }
+    //这一轮谁都拿不到：转完一整圈顺序不变，先把这一轮的配额加上
+    //再算欠得最少的租户还要几轮才能变正，前面那些谁都拿不到的轮次一次加完，剩下最后一轮交给轮转
+    int64_t rounds = -1;
+    for (int tenant : active_)
+    {
+        Tenant& t = tenants_[tenant];
+        int64_t quantum = TENANT_QUANTUM * t.weight;
+        if (!t.visited)
+        {
+            t.deficit += quantum;
+        }
+        t.visited = false;
+        int64_t need = -t.deficit / quantum + 1;
+        rounds = rounds < 0 ? need : std::min(rounds, need);
+    }
+    for (int tenant : active_)
+    {
+        Tenant& t = tenants_[tenant];
+        t.deficit += (rounds - 1) * TENANT_QUANTUM * t.weight;
+    }
+}
+
+void FairTaskQueue::deactivate(int tenant)
+{
+    Tenant& t = tenants_[tenant];
+    t.active = false;
+    t.visited = false;
+    t.deficit = std::min<int64_t>(t.deficit, 0);
+}
+
+std::vector<TenantStats> FairTaskQueue::stats() const
+{
+    std::vector<TenantStats> stats;
+    stats.reserve(tenants_.size());
+    for (size_t i = 0; i < tenants_.size(); i++)
+    {
+        const Tenant& t = tenants_[i];
+        stats.push_back(TenantStats{static_cast<int>(i), t.name, t.weight, static_cast<int>(t.tasks.size()),
+            t.executed, t.runTime});
+    }
+    return stats;
+}
@@ -0,0 +1,77 @@
+#include "hill_climbing.h"
+#include <algorithm>
+
+const double THROUGHPUT_GAIN_THRESHOLD = 0.05;//吞吐量变化超过5%才认为是线程数变化带来的，否则当作噪声
+const int HILL_CLIMBING_MAX_STEP = 8;//单次最多调整的线程数
+
+HillClimbing::HillClimbing(int minThreads, int maxThreads)
+    : minThreads_(minThreads)
+    , maxThreads_(maxThreads)
+    , lastThreads_(0)
+    , lastThroughput_(0)
+    , direction_(1)
+    , step_(1)
+    , hasSample_(false)
+{}
+
+void HillClimbing::setBounds(int minThreads, int maxThreads)
+{
+    minThreads_ = std::max(1, minThreads);
+    maxThreads_ = std::max(minThreads_, maxThreads);
+}
+
+void HillClimbing::reset()
+{
+    hasSample_ = false;
+    direction_ = 1;
+    step_ = 1;
+}
+
+int HillClimbing::clamp(int threads) const
+{
+    return std::min(maxThreads_, std::max(minThreads_, threads));
+}
+
+int HillClimbing::update(int curThreads, double throughput)
+{
+    if (!hasSample_)
+    {
+        //第一个样本，先试探着加一个线程
+        hasSample_ = true;
+        lastThreads_ = curThreads;
+        lastThroughput_ = throughput;
+        return clamp(curThreads + direction_);
+    }
+
+    double gain = (throughput - lastThroughput_) / std::max(lastThroughput_, 1.0);
+    if (curThreads == lastThreads_)
+    {
+        //线程数没变(到了边界，或者上次的调整还没生效)，只刷新基准，继续按原方向试探
+        lastThroughput_ = throughput;
+        return clamp(curThreads + direction_ * step_);
+    }
+
+    bool added = curThreads > lastThreads_;
+    int direction;
+    if (gain > THROUGHPUT_GAIN_THRESHOLD)
+    {
+        //上一次调整有收益，保持方向
+        direction = added ? 1 : -1;
+    }
+    else if (gain < -THROUGHPUT_GAIN_THRESHOLD)
+    {
+        //上一次调整让吞吐量下降了，反方向走
+        direction = added ? -1 : 1;
+    }
+    else
+    {
+        //没有明显变化，少用一个线程
+        direction = -1;
+    }
+    //同方向连续有收益就加大步长，IO密集的任务可以很快爬到需要的线程数
+    step_ = (direction == direction_ && gain > THROUGHPUT_GAIN_THRESHOLD) ? std::min(step_ * 2, HILL_CLIMBING_MAX_STEP) : 1;
+    direction_ = direction;
+    lastThreads_ = curThreads;
+    lastThroughput_ = throughput;
+    return clamp(curThreads + direction_ * step_);
+}
@@ -0,0 +1,120 @@
+#include "histogram.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+    for (auto& bucket : buckets_)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+int LatencyHistogram::bucketIndex(uint64_t ns)
+{
+    if (ns < static_cast<uint64_t>(SUB_BUCKETS))
+    {
+        return static_cast<int>(ns);
+    }
+    int exponent = 63 - __builtin_clzll(ns);
+    if (exponent >= MAX_EXPONENT)
+    {
+        return BUCKET_SIZE - 1;
+    }
+    //每一段[2^e, 2^(e+1))用最高位下面的4位选桶
+    int sub = static_cast<int>((ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < SUB_BUCKETS)
+    {
+        return index;
+    }
+    int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    uint64_t sub = index % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub + 1) << (exponent - SUB_BUCKET_BITS)) - 1;
+}
+
+HistogramSnapshot::HistogramSnapshot()
+    : counts_(LatencyHistogram::BUCKET_SIZE, 0)
+    , count_(0)
+{}
+
+void HistogramSnapshot::add(const LatencyHistogram& histogram)
+{
+    for (int i = 0; i < LatencyHistogram::BUCKET_SIZE; i++)
+    {
+        uint64_t n = histogram.bucketCount(i);
+        counts_[i] += n;
+        count_ += n;
+    }
+}
+
+void HistogramSnapshot::add(const HistogramSnapshot& other)
+{
+    for (int i = 0; i < LatencyHistogram::BUCKET_SIZE; i++)
+    {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+}
+
+void HistogramSnapshot::record(uint64_t ns)
+{
+    counts_[LatencyHistogram::bucketIndex(ns)]++;
+    count_++;
+}
+
+uint64_t HistogramSnapshot::percentile(double p) const
+{
+    if (count_ == 0)
+    {
+        return 0;
+    }
+    //第rank个值(从1开始)落在哪个桶
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * count_ + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < LatencyHistogram::BUCKET_SIZE; i++)
+    {
+        seen += counts_[i];
+        if (seen >= rank)
+        {
+            return LatencyHistogram::bucketUpperBound(i);
+        }
+    }
+    return max();
+}
+
+uint64_t HistogramSnapshot::max() const
+{
+    for (int i = LatencyHistogram::BUCKET_SIZE - 1; i >= 0; i--)
+    {
+        if (counts_[i] > 0)
+        {
+            return LatencyHistogram::bucketUpperBound(i);
+        }
+    }
+    return 0;
+}
+
+double HistogramSnapshot::mean() const
+{
+    if (count_ == 0)
+    {
+        return 0;
+    }
+    //用桶的中点近似
+    double sum = 0;
+    uint64_t lower = 0;
+    for (int i = 0; i < LatencyHistogram::BUCKET_SIZE; i++)
+    {
+        uint64_t upper = LatencyHistogram::bucketUpperBound(i);
+        sum += counts_[i] * ((lower + upper) / 2.0);
+        lower = upper + 1;
+    }
+    return sum / count_;
+}
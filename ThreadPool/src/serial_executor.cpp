@@ -0,0 +1,74 @@
+#include "serial_executor.h"
+#include "threadpool.h"
+
+class SerialExecutor::Activation : public Task
+{
+public:
+    explicit Activation(std::shared_ptr<SerialExecutor> executor)
+        : executor_(std::move(executor))
+    {}
+    Any run()
+    {
+        executor_->drain();
+        return 0;
+    }
+private:
+    //激活在队列里被取消，执行器里排着的元素也不会处理了
+    void cancel()
+    {
+        executor_->dropAll();
+        Task::cancel();
+    }
+    std::shared_ptr<SerialExecutor> executor_; //激活执行完之前执行器不会析构
+};
+
+SerialExecutor::SerialExecutor(ThreadPool& pool, int batch)
+    : pool_(pool)
+    , batch_(batch > 0 ? batch : 1)
+    , pending_(0)
+{}
+
+void SerialExecutor::post()
+{
+    //原来没有待处理的元素，说明没有激活在跑，由这次提交负责启动
+    if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0 && !schedule())
+    {
+        drain();
+    }
+}
+
+bool SerialExecutor::schedule()
+{
+    SubmitStatus status = pool_.submitTask(std::make_shared<Activation>(shared_from_this())).getStatus();
+    return status == SubmitStatus::ACCEPTED || status == SubmitStatus::RAN_IN_CALLER;
+}
+
+void SerialExecutor::drain()
+{
+    for (int count = 1;; count++)
+    {
+        processOne();
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            return;
+        }
+        //还有元素，但这一批已经处理够了，排到线程池队尾让别的任务先执行
+        //这批元素已经被接收过了，不再走拒绝策略(工作线程不能阻塞在队列满上)，只有shutdown之后才会失败，那就接着在这里处理
+        if (count >= batch_ && pool_.requeue(std::make_shared<Activation>(shared_from_this())))
+        {
+            return;
+        }
+    }
+}
+
+void SerialExecutor::dropAll()
+{
+    for (;;)
+    {
+        discardOne();
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#include "strand.h"
+#include "threadpool.h"
+
+namespace
+{
+//一次drain最多连续执行的任务数
+const int STRAND_BATCH = 64;
+}
+
+Strand::Strand(ThreadPool& pool)
+    : SerialExecutor(pool, STRAND_BATCH)
+{}
+
+Result Strand::submitTask(std::shared_ptr<Task> sp)
+{
+    queue_.push(sp);
+    post();
+    return Result(sp);
+}
+
+void Strand::processOne()
+{
+    std::shared_ptr<Task> task = popPending(queue_);
+    if (task->token_.stop_requested())
+    {
+        task->cancel();
+    }
+    else
+    {
+        task->exec();
+    }
+}
+
+void Strand::discardOne()
+{
+    popPending(queue_)->cancel();
+}
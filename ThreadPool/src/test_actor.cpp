@@ -0,0 +1,186 @@
+#include "threadpool.h"
+#include "actor.h"
+#include "test_check.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+/*
+跑在线程池上的Actor
+1. 多个发送者同时发，每个发送者的消息按顺序处理，behavior不会被并发调用
+2. 大量actor各发一条消息都能处理完，处理完的actor不留在线程池队列里
+3. 一次激活最多处理throughput条，剩下的排到队尾，别的actor能插进来
+4. behavior抛异常只算这一条失败，后面的照常处理
+5. 激活还在排队时shutdown(CANCEL_PENDING)，邮箱里的消息丢弃；shutdown之后发的消息在发送线程里处理
+*/
+namespace
+{
+//让唯一的工作线程一直忙着，激活只能在队列里排着
+Result blockPool(ThreadPool& pool)
+{
+    BlockTask::release = false;
+    Result blocker = pool.submitTask(std::make_shared<BlockTask>());
+    CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+    return blocker;
+}
+
+struct Message
+{
+    int sender = 0;
+    int seq = 0;
+};
+
+void testOrderAndExclusion()
+{
+    const int SENDERS = 4;
+    const int MESSAGES = 1000;
+    ThreadPool pool;
+    pool.start(4);
+    //lastSeq只在behavior里访问，actor保证不会并发；结果在主线程里读，用原子变量
+    int lastSeq[SENDERS] = {-1, -1, -1, -1};
+    std::atomic_int outOfOrder{0};
+    std::atomic_int processed{0};
+    std::atomic_bool running{false};
+    std::atomic_int overlaps{0};
+    auto actor = spawnActor<Message>(pool, [&](Message& msg) {
+        if (running.exchange(true))
+        {
+            overlaps++;
+        }
+        if (msg.seq != lastSeq[msg.sender] + 1)
+        {
+            outOfOrder++;
+        }
+        lastSeq[msg.sender] = msg.seq;
+        processed++;
+        running = false;
+    });
+    std::vector<std::thread> senders;
+    for (int sender = 0; sender < SENDERS; sender++)
+    {
+        senders.emplace_back([&, sender]() {
+            for (int seq = 0; seq < MESSAGES; seq++)
+            {
+                Message msg;
+                msg.sender = sender;
+                msg.seq = seq;
+                actor->tell(msg);
+            }
+        });
+    }
+    for (std::thread& t : senders)
+    {
+        t.join();
+    }
+    CHECK(waitFor([&]() { return actor->pending() == 0; }));
+    CHECK(processed == SENDERS * MESSAGES);
+    CHECK(outOfOrder == 0);
+    CHECK(overlaps == 0);
+}
+
+void testManyActors()
+{
+    const int ACTORS = 10000;
+    ThreadPool pool;
+    pool.start(2);
+    std::atomic_int processed{0};
+    std::vector<std::shared_ptr<Actor<int>>> actors;
+    for (int i = 0; i < ACTORS; i++)
+    {
+        actors.push_back(spawnActor<int>(pool, [&](int& value) { processed += value; }));
+    }
+    for (auto& actor : actors)
+    {
+        actor->tell(1);
+    }
+    CHECK(waitFor([&]() { return processed == ACTORS; }));
+    //邮箱空了的actor不在队列里
+    CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+    for (auto& actor : actors)
+    {
+        CHECK(actor->pending() == 0);
+    }
+}
+
+void testThroughput()
+{
+    ThreadPool pool;
+    pool.start(1);
+    Result blocker = blockPool(pool);
+    std::atomic_int busyProcessed{0};
+    std::atomic_int seenByOther{-1};
+    auto busy = spawnActor<int>(pool, [&](int&) { busyProcessed++; }, 8);
+    auto other = spawnActor<int>(pool, [&](int&) { seenByOther = busyProcessed.load(); });
+    for (int i = 0; i < 100; i++)
+    {
+        busy->tell(i);
+    }
+    //other的激活排在busy后面
+    other->tell(0);
+    BlockTask::release = true;
+    CHECK(waitFor([&]() { return busy->pending() == 0 && other->pending() == 0; }));
+    CHECK(busyProcessed == 100);
+    //busy处理完一批8条就让出线程
+    CHECK(seenByOther == 8);
+}
+
+void testFailure()
+{
+    ThreadPool pool;
+    pool.start(1);
+    std::atomic_int processed{0};
+    auto actor = spawnActor<int>(pool, [&](int& value) {
+        processed++;
+        if (value % 2 == 1)
+        {
+            throw std::runtime_error("odd");
+        }
+    });
+    for (int i = 0; i < 10; i++)
+    {
+        actor->tell(i);
+    }
+    CHECK(waitFor([&]() { return actor->pending() == 0; }));
+    CHECK(processed == 10);
+    CHECK(actor->getFailed() == 5);
+}
+
+void testCancelAndShutdown()
+{
+    ThreadPool pool;
+    pool.start(1);
+    Result blocker = blockPool(pool);
+    std::atomic_int processed{0};
+    auto actor = spawnActor<int>(pool, [&](int&) { processed++; });
+    for (int i = 0; i < 5; i++)
+    {
+        actor->tell(i);
+    }
+    CHECK(actor->pending() == 5);
+    std::thread releaser([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        BlockTask::release = true;
+    });
+    //排着的激活被丢弃
+    CHECK(pool.shutdown(ShutdownMode::CANCEL_PENDING) == 1);
+    releaser.join();
+    CHECK(processed == 0);
+    CHECK(actor->getDropped() == 5);
+    CHECK(actor->pending() == 0);
+    //线程池已经shutdown，消息在发送线程里处理
+    actor->tell(0);
+    CHECK(processed == 1);
+    CHECK(actor->pending() == 0);
+}
+}
+
+int main()
+{
+    testOrderAndExclusion();
+    testManyActors();
+    testThroughput();
+    testFailure();
+    testCancelAndShutdown();
+    return testResult();
+}
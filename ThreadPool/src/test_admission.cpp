@@ -0,0 +1,102 @@
+#include "threadpool.h"
+#include "test_check.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+/*
+按排队延迟的准入控制(CoDel)
+一个线程，每个任务5ms，一次提交几十个，排队时间很快超过target：
+1. 持续超过interval后判定过载，新提交的LOW任务返回SHED，NORMAL照常进队列
+2. 已经在排队的LOW任务出队时丢弃，get()返回空值
+3. 队列排空以后解除过载，LOW任务又能提交
+*/
+namespace
+{
+std::shared_ptr<Task> makeTask(std::atomic_int& done, TaskPriority priority)
+{
+    auto task = std::make_shared<SleepTask>(std::chrono::milliseconds(5), 0, &done);
+    task->setPriority(priority);
+    return task;
+}
+
+void testShedding()
+{
+    ThreadPool pool;
+    pool.setAdmissionControl(std::chrono::milliseconds(10), std::chrono::milliseconds(30));
+    pool.start(1);
+    std::atomic_int done{0};
+    std::vector<Result> normal;
+    std::vector<Result> low;
+    //还没过载，LOW任务照样进队列
+    for (int i = 0; i < 20; i++)
+    {
+        normal.push_back(pool.submitTask(makeTask(done, TaskPriority::NORMAL)));
+    }
+    for (int i = 0; i < 10; i++)
+    {
+        low.push_back(pool.submitTask(makeTask(done, TaskPriority::LOW)));
+        CHECK(low.back().getStatus() == SubmitStatus::ACCEPTED);
+    }
+    for (int i = 0; i < 20; i++)
+    {
+        normal.push_back(pool.submitTask(makeTask(done, TaskPriority::NORMAL)));
+    }
+    CHECK(waitFor([&]() { return pool.stats().overloaded; }));
+
+    //过载期间：LOW被拒绝，NORMAL不受影响
+    Result shed = pool.submitTask(makeTask(done, TaskPriority::LOW));
+    CHECK(shed.getStatus() == SubmitStatus::SHED);
+    CHECK(shed.getState() == ResultState::REJECTED);
+    normal.push_back(pool.submitTask(makeTask(done, TaskPriority::NORMAL)));
+    CHECK(normal.back().getStatus() == SubmitStatus::ACCEPTED);
+
+    //不要在排空之前调用get()：get()会把还在排队的任务拿到调用者线程里执行，量不到排队时间
+    CHECK(waitFor([&]() { return done == static_cast<int>(normal.size()); }));
+    CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+    for (Result& r : normal)
+    {
+        CHECK(r.getState() != ResultState::REJECTED);
+        r.get();
+        CHECK(r.getState() == ResultState::OK);
+    }
+    //排在后面的LOW任务出队时排队时间早就超标了，全部丢弃
+    for (Result& r : low)
+    {
+        CHECK(!r.get().hasValue());
+        CHECK(r.getState() == ResultState::CANCELLED);
+    }
+    CHECK(pool.stats().shed == low.size() + 1);
+
+    //队列排空，过载解除，LOW任务可以提交了
+    CHECK(waitFor([&]() { return !pool.stats().overloaded; }));
+    Result after = pool.submitTask(makeTask(done, TaskPriority::LOW));
+    CHECK(after.getStatus() == SubmitStatus::ACCEPTED);
+    after.get();
+    CHECK(after.getState() == ResultState::OK);
+}
+
+//target为0(默认)不做准入控制，排多久都不算过载
+void testDisabled()
+{
+    ThreadPool pool;
+    pool.start(1);
+    std::atomic_int done{0};
+    std::vector<Result> results;
+    for (int i = 0; i < 30; i++)
+    {
+        results.push_back(pool.submitTask(makeTask(done, TaskPriority::LOW)));
+    }
+    CHECK(waitFor([&]() { return done == 30; }));
+    PoolStats stats = pool.stats();
+    CHECK(!stats.overloaded);
+    CHECK(stats.shed == 0);
+}
+}
+
+int main()
+{
+    testShedding();
+    testDisabled();
+    return testResult();
+}
@@ -0,0 +1,162 @@
+#include "threadpool.h"
+#include "fair_queue.h"
+#include "cancellation.h"
+#include "test_check.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+/*
+取消令牌
+1. 出队前token已经取消的任务不执行，Result是CANCELLED，tasksCancelled计数；get()自己领走的也一样
+2. 同一个source的token一起取消，没拿token的任务照常执行
+3. 没有执行的任务把pop时预扣的配额还给租户：FairTaskQueue按refund之后的配额继续轮转，线程池里它不算执行数和执行时间
+*/
+namespace
+{
+//记下自己被执行了几次
+class CountTask : public Task
+{
+public:
+    Any run()
+    {
+        runs_++;
+        return 1;
+    }
+    int getRuns() const { return runs_; }
+private:
+    std::atomic_int runs_{0};
+};
+
+void testSkippedBeforeDequeue()
+{
+    ThreadPool pool;
+    pool.start(1);
+    BlockTask::release = false;
+    Result blocker = pool.submitTask(std::make_shared<BlockTask>());
+    CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+    CancellationSource source;
+    std::vector<std::shared_ptr<CountTask>> cancelled;
+    std::vector<Result> cancelledResults;
+    for (int i = 0; i < 3; i++)
+    {
+        cancelled.push_back(std::make_shared<CountTask>());
+        cancelledResults.push_back(pool.submitTask(cancelled.back(), source.token()));
+    }
+    auto normal = std::make_shared<CountTask>();
+    Result normalResult = pool.submitTask(normal);
+    //任务都还在排队
+    source.request_stop();
+    BlockTask::release = true;
+    //工作线程出队时跳过，不用get()去领
+    CHECK(waitFor([&]() {
+        PoolStats stats = pool.stats();
+        return stats.total.tasksCancelled == 3 && stats.total.tasksExecuted == 2;
+    }));
+    CHECK(normalResult.get().cast_<int>() == 1);
+    for (size_t i = 0; i < cancelled.size(); i++)
+    {
+        CHECK(!cancelledResults[i].get().hasValue());
+        CHECK(cancelledResults[i].getState() == ResultState::CANCELLED);
+        CHECK(cancelledResults[i].isCancelled());
+        CHECK(cancelled[i]->getRuns() == 0);
+    }
+    CHECK(normal->getRuns() == 1);
+    CHECK(pool.stats().steals == 0);
+}
+
+void testSkippedByGet()
+{
+    ThreadPool pool;
+    pool.start(1);
+    BlockTask::release = false;
+    Result blocker = pool.submitTask(std::make_shared<BlockTask>());
+    CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+    CancellationSource source;
+    auto task = std::make_shared<CountTask>();
+    Result r = pool.submitTask(task, source.token());
+    source.request_stop();
+    //get()领走了，发现已经取消，也不执行
+    CHECK(!r.get().hasValue());
+    CHECK(r.getState() == ResultState::CANCELLED);
+    CHECK(task->getRuns() == 0);
+    PoolStats stats = pool.stats();
+    CHECK(stats.steals == 1);
+    CHECK(stats.total.tasksCancelled == 1);
+    CHECK(stats.queueDepth == 0);
+    BlockTask::release = true;
+}
+
+//每个任务预扣60us，配额100us：不还的话一轮只能取两个；没执行的任务还回去，配额一直够用
+void testQueueRefund()
+{
+    const int64_t COST = 60000;
+    FairTaskQueue queue;
+    int a = queue.addTenant("a", 1);
+    int b = queue.addTenant("b", 1);
+    //先让a的平均执行时间变成COST
+    queue.charge(a, 0, COST);
+    for (int i = 0; i < 5; i++)
+    {
+        queue.push(std::make_shared<CountTask>(), a);
+        queue.push(std::make_shared<CountTask>(), b);
+    }
+    //a的任务都被丢弃，把配额还回去，a一直排在前面，直到它的任务取完
+    for (int i = 0; i < 5; i++)
+    {
+        int tenant = -1;
+        int64_t charged = 0;
+        CHECK(queue.pop(tenant, charged) != nullptr);
+        CHECK(tenant == a);
+        CHECK(charged == COST);
+        queue.refund(tenant, charged);
+    }
+    std::vector<TenantStats> stats = queue.stats();
+    CHECK(stats[a].queued == 0);
+    CHECK(stats[b].queued == 5);
+    //没执行的不算执行数
+    CHECK(stats[a].executed == 1);
+    CHECK(stats[b].executed == 0);
+}
+
+void testPoolRefund()
+{
+    ThreadPool pool;
+    int cancelledTenant = pool.registerTenant("cancelled", 1);
+    int normalTenant = pool.registerTenant("normal", 1);
+    CancellationSource source;
+    source.request_stop();
+    std::vector<Result> results;
+    for (int i = 0; i < 20; i++)
+    {
+        auto cancelled = std::make_shared<SleepTask>();
+        cancelled->setTenant(cancelledTenant);
+        results.push_back(pool.submitTask(cancelled, source.token()));
+        auto normal = std::make_shared<SleepTask>();
+        normal->setTenant(normalTenant);
+        results.push_back(pool.submitTask(normal));
+    }
+    pool.start(1);
+    CHECK(pool.shutdown(ShutdownMode::DRAIN) == 0);
+    int cancelledCount = 0;
+    for (Result& r : results)
+    {
+        cancelledCount += r.getState() == ResultState::CANCELLED ? 1 : 0;
+    }
+    CHECK(cancelledCount == 20);
+    PoolStats stats = pool.stats();
+    CHECK(stats.total.tasksCancelled == 20);
+    CHECK(stats.tenants[cancelledTenant].executed == 0);
+    CHECK(stats.tenants[cancelledTenant].runTime == 0);
+    CHECK(stats.tenants[normalTenant].executed == 20);
+}
+}
+
+int main()
+{
+    testSkippedBeforeDequeue();
+    testSkippedByGet();
+    testQueueRefund();
+    testPoolRefund();
+    return testResult();
+}
@@ -0,0 +1,159 @@
+#include "threadpool.h"
+#include "fair_queue.h"
+#include "cancellation.h"
+#include "test_check.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+/*
+多租户的DRR调度
+1. FairTaskQueue本身：两个租户都在排队时，按weight分执行时间；一个租户内部是FIFO；remove拿掉指定任务
+2. 线程池里：权重1和3的两个租户一起压满，执行时间大约1:3
+3. 没有执行的任务(取消令牌)不算进租户的执行数
+4. 所有租户都欠着很多轮配额时一次补齐，轮到的先后和一轮一轮补一样
+*/
+namespace
+{
+void testQueueShares()
+{
+    FairTaskQueue queue;
+    int light = queue.addTenant("light", 1);
+    int heavy = queue.addTenant("heavy", 3);
+    CHECK(queue.addTenant("light", 1) == light);
+    for (int i = 0; i < 1000; i++)
+    {
+        queue.push(std::make_shared<SleepTask>(std::chrono::milliseconds(1), i), light);
+        queue.push(std::make_shared<SleepTask>(std::chrono::milliseconds(1), i), heavy);
+    }
+    //每个任务都按50us执行完，两个租户一直有任务，取400个看比例
+    int popped[2] = {0, 0};
+    int lastId[2] = {-1, -1};
+    for (int i = 0; i < 400; i++)
+    {
+        int tenant = -1;
+        int64_t charged = 0;
+        std::shared_ptr<Task> task = queue.pop(tenant, charged);
+        CHECK(task != nullptr && (tenant == light || tenant == heavy));
+        int index = tenant == light ? 0 : 1;
+        //同一个租户按提交顺序出来
+        int id = static_cast<SleepTask*>(task.get())->getId();
+        CHECK(id == lastId[index] + 1);
+        lastId[index] = id;
+        popped[index]++;
+        queue.charge(tenant, charged, 50000);
+    }
+    double ratio = static_cast<double>(popped[1]) / popped[0];
+    CHECK(ratio > 2.5 && ratio < 3.5);
+
+    std::vector<TenantStats> stats = queue.stats();
+    CHECK(stats[light].executed == static_cast<uint64_t>(popped[0]));
+    CHECK(stats[heavy].executed == static_cast<uint64_t>(popped[1]));
+    CHECK(stats[light].queued == 1000 - popped[0]);
+}
+
+void testQueueRemove()
+{
+    FairTaskQueue queue;
+    auto a = std::make_shared<SleepTask>(std::chrono::milliseconds(1), 1);
+    auto b = std::make_shared<SleepTask>(std::chrono::milliseconds(1), 2);
+    auto c = std::make_shared<SleepTask>(std::chrono::milliseconds(1), 3);
+    queue.push(a, FairTaskQueue::DEFAULT_TENANT);
+    queue.push(b, FairTaskQueue::DEFAULT_TENANT);
+    //不存在的租户放进DEFAULT_TENANT，remove时也一样找
+    queue.push(c, 42);
+    int tenant = FairTaskQueue::DEFAULT_TENANT;
+    CHECK(queue.remove(b.get(), tenant));
+    CHECK(!queue.remove(b.get(), tenant));
+    tenant = 42;
+    CHECK(queue.remove(c.get(), tenant));
+    CHECK(tenant == FairTaskQueue::DEFAULT_TENANT);
+    CHECK(queue.size() == 1);
+    int64_t charged = 0;
+    CHECK(queue.pop(tenant, charged) == a);
+    CHECK(queue.empty());
+}
+
+//两个租户都欠了很多轮的配额，一次算完以后还是按欠的轮数先后轮到
+void testQueueLargeDebt()
+{
+    FairTaskQueue queue;
+    int a = queue.addTenant("a", 1);
+    int b = queue.addTenant("b", 2);
+    for (int i = 0; i < 2; i++)
+    {
+        queue.push(std::make_shared<SleepTask>(), a);
+        queue.push(std::make_shared<SleepTask>(), b);
+    }
+    const int64_t DEBT = 1000000000000; //1000s，要转一千万轮
+    int tenant = -1;
+    int64_t charged = 0;
+    CHECK(queue.pop(tenant, charged) != nullptr && tenant == a);
+    queue.charge(tenant, charged, DEBT);
+    CHECK(queue.pop(tenant, charged) != nullptr && tenant == b);
+    queue.charge(tenant, charged, DEBT);
+    //b的权重是a的两倍，欠的一样多，先还清
+    CHECK(queue.pop(tenant, charged) != nullptr && tenant == b);
+    CHECK(queue.pop(tenant, charged) != nullptr && tenant == a);
+    CHECK(queue.empty());
+}
+
+void testPoolShares()
+{
+    ThreadPool pool;
+    int light = pool.registerTenant("light", 1);
+    int heavy = pool.registerTenant("heavy", 3);
+    //先都放进队列再启动，从第一个任务开始两个租户就都在排队
+    std::vector<Result> results;
+    for (int i = 0; i < 400; i++)
+    {
+        for (int tenant : {light, heavy})
+        {
+            auto task = std::make_shared<SleepTask>();
+            task->setTenant(tenant);
+            results.push_back(pool.submitTask(task));
+        }
+    }
+    pool.start(1);
+    auto executed = [&]()->uint64_t {
+        std::vector<TenantStats> tenants = pool.stats().tenants;
+        return tenants[light].executed + tenants[heavy].executed;
+    };
+    CHECK(waitFor([&]() { return executed() >= 120; }));
+    std::vector<TenantStats> tenants = pool.stats().tenants;
+    CHECK(tenants[light].executed > 0);
+    double ratio = static_cast<double>(tenants[heavy].runTime) / std::max<uint64_t>(tenants[light].runTime, 1);
+    CHECK(ratio > 2 && ratio < 4.5);
+    pool.shutdown(ShutdownMode::CANCEL_PENDING);
+}
+
+void testCancelledNotCharged()
+{
+    ThreadPool pool;
+    int tenant = pool.registerTenant("tenant", 1);
+    pool.start(1);
+    CancellationSource source;
+    source.request_stop();
+    auto cancelled = std::make_shared<SleepTask>();
+    cancelled->setTenant(tenant);
+    Result r1 = pool.submitTask(cancelled, source.token());
+    auto normal = std::make_shared<SleepTask>();
+    normal->setTenant(tenant);
+    Result r2 = pool.submitTask(normal);
+    pool.shutdown(ShutdownMode::DRAIN);
+    CHECK(r1.getState() == ResultState::CANCELLED);
+    CHECK(r2.getState() == ResultState::OK);
+    CHECK(pool.stats().tenants[tenant].executed == 1);
+}
+}
+
+int main()
+{
+    testQueueShares();
+    testQueueRemove();
+    testQueueLargeDebt();
+    testPoolShares();
+    testCancelledNotCharged();
+    return testResult();
+}
@@ -0,0 +1,137 @@
+#include "threadpool.h"
+#include "test_check.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+/*
+任务队列满时每种RejectPolicy的行为
+一个线程被BlockTask占着，队列上限1，再放一个任务队列就满了，这时候再提交第三个
+*/
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+//记下在哪个线程执行的
+class IdTask : public Task
+{
+public:
+    Any run()
+    {
+        threadId_ = std::this_thread::get_id();
+        return 1;
+    }
+    std::thread::id threadId_;
+};
+
+//唯一的线程在执行BlockTask，队列里有一个任务，已经满了
+struct FullPool
+{
+    explicit FullPool(RejectPolicy policy, std::chrono::milliseconds timeout = std::chrono::seconds(1))
+    {
+        BlockTask::release = false;
+        pool.setTaskQueMaxThreshold(1);
+        pool.setRejectPolicy(policy, timeout);
+        pool.start(1);
+        blocker = std::make_unique<Result>(pool.submitTask(std::make_shared<BlockTask>()));
+        CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+        queued = std::make_shared<IdTask>();
+        first = std::make_unique<Result>(pool.submitTask(queued));
+        CHECK(first->getStatus() == SubmitStatus::ACCEPTED);
+    }
+    ~FullPool()
+    {
+        BlockTask::release = true;
+    }
+    ThreadPool pool;
+    std::unique_ptr<Result> blocker;
+    std::shared_ptr<IdTask> queued;
+    std::unique_ptr<Result> first;
+};
+
+void testBlock()
+{
+    FullPool full(RejectPolicy::BLOCK);
+    std::atomic_bool submitted{false};
+    SubmitStatus status = SubmitStatus::QUEUE_FULL;
+    std::thread producer([&]() {
+        status = full.pool.submitTask(std::make_shared<IdTask>()).getStatus();
+        submitted = true;
+    });
+    //队列一直满着，提交者一直等
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(!submitted);
+    BlockTask::release = true;
+    producer.join();
+    CHECK(status == SubmitStatus::ACCEPTED);
+    CHECK(full.pool.stats().blocked == 1);
+}
+
+void testBlockTimeout()
+{
+    FullPool full(RejectPolicy::BLOCK_TIMEOUT, std::chrono::milliseconds(100));
+    auto begin = Clock::now();
+    Result r = full.pool.submitTask(std::make_shared<IdTask>());
+    auto waited = Clock::now() - begin;
+    CHECK(r.getStatus() == SubmitStatus::QUEUE_FULL);
+    CHECK(r.getState() == ResultState::REJECTED);
+    CHECK(waited >= std::chrono::milliseconds(100));
+    PoolStats stats = full.pool.stats();
+    CHECK(stats.blocked == 1);
+    CHECK(stats.rejected == 1);
+}
+
+void testFailFast()
+{
+    FullPool full(RejectPolicy::FAIL_FAST);
+    auto begin = Clock::now();
+    Result r = full.pool.submitTask(std::make_shared<IdTask>());
+    auto waited = Clock::now() - begin;
+    CHECK(r.getStatus() == SubmitStatus::QUEUE_FULL);
+    CHECK(!r.get().hasValue());
+    CHECK(waited < std::chrono::milliseconds(50));
+    PoolStats stats = full.pool.stats();
+    CHECK(stats.blocked == 0);
+    CHECK(stats.rejected == 1);
+}
+
+void testCallerRuns()
+{
+    FullPool full(RejectPolicy::CALLER_RUNS);
+    auto task = std::make_shared<IdTask>();
+    Result r = full.pool.submitTask(task);
+    //submitTask返回时已经在提交线程里执行完了
+    CHECK(r.getStatus() == SubmitStatus::RAN_IN_CALLER);
+    CHECK(task->threadId_ == std::this_thread::get_id());
+    CHECK(r.get().cast_<int>() == 1);
+    PoolStats stats = full.pool.stats();
+    CHECK(stats.callerRuns == 1);
+    CHECK(stats.queueDepth == 1);
+}
+
+void testDropOldest()
+{
+    FullPool full(RejectPolicy::DROP_OLDEST);
+    Result r = full.pool.submitTask(std::make_shared<IdTask>());
+    CHECK(r.getStatus() == SubmitStatus::ACCEPTED);
+    //排在队头的任务被挤掉，它的get()不会等
+    CHECK(!full.first->get().hasValue());
+    CHECK(full.first->isCancelled());
+    CHECK(full.first->getState() == ResultState::CANCELLED);
+    PoolStats stats = full.pool.stats();
+    CHECK(stats.dropped == 1);
+    CHECK(stats.queueDepth == 1);
+    BlockTask::release = true;
+    CHECK(r.get().cast_<int>() == 1);
+}
+}
+
+int main()
+{
+    testBlock();
+    testBlockTimeout();
+    testFailFast();
+    testCallerRuns();
+    testDropOldest();
+    return testResult();
+}
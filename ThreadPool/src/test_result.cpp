@@ -0,0 +1,155 @@
+#include "threadpool.h"
+#include "test_check.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <utility>
+/*
+Result的返回值、异常和状态
+1. run抛出的异常在get()里原样重新抛出，工作线程执行的和get()自己执行的都一样，getState()是FAILED
+2. cast_的类型和返回值不一致、或者Any是空的，抛BadAnyCast(也能当std::bad_cast接住)
+3. 提交失败是REJECTED，排着被shutdown丢弃是CANCELLED，被移走的Result是INVALID，get()都不阻塞
+*/
+namespace
+{
+class ThrowTask : public Task
+{
+public:
+    Any run()
+    {
+        throw std::runtime_error("task failed");
+    }
+};
+
+class ValueTask : public Task
+{
+public:
+    explicit ValueTask(int value) : value_(value) {}
+    Any run()
+    {
+        return value_;
+    }
+private:
+    int value_;
+};
+
+//get()抛出run里的那个异常，返回异常信息
+std::string getError(Result& r)
+{
+    try
+    {
+        r.get();
+    }
+    catch (const std::runtime_error& e)
+    {
+        return e.what();
+    }
+    return "";
+}
+
+void testException()
+{
+    ThreadPool pool;
+    pool.start(1);
+    //工作线程执行的
+    Result onWorker = pool.submitTask(std::make_shared<ThrowTask>());
+    CHECK(waitFor([&]() { return pool.stats().total.tasksFailed == 1; }));
+    CHECK(getError(onWorker) == "task failed");
+    CHECK(onWorker.getState() == ResultState::FAILED);
+    //还在排队，get()自己执行的
+    BlockTask::release = false;
+    Result blocker = pool.submitTask(std::make_shared<BlockTask>());
+    CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+    Result inCaller = pool.submitTask(std::make_shared<ThrowTask>());
+    CHECK(getError(inCaller) == "task failed");
+    CHECK(inCaller.getState() == ResultState::FAILED);
+    CHECK(pool.stats().steals == 1);
+    BlockTask::release = true;
+    blocker.get();
+    //抛异常的任务不影响工作线程，后面的任务照常执行
+    Result after = pool.submitTask(std::make_shared<ValueTask>(7));
+    CHECK(after.get().cast_<int>() == 7);
+    CHECK(after.getState() == ResultState::OK);
+}
+
+void testBadCast()
+{
+    ThreadPool pool;
+    pool.start(1);
+    Result r = pool.submitTask(std::make_shared<ValueTask>(7));
+    Any value = r.get();
+    bool thrown = false;
+    try
+    {
+        value.cast_<long>();
+    }
+    catch (const BadAnyCast&)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    //类型对的照样能取
+    CHECK(value.cast_<int>() == 7);
+    //空的Any也一样，按std::bad_cast接住
+    Any empty;
+    CHECK(!empty.hasValue());
+    thrown = false;
+    try
+    {
+        empty.cast_<int>();
+    }
+    catch (const std::bad_cast&)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+void testStates()
+{
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshold(1);
+    pool.setRejectPolicy(RejectPolicy::FAIL_FAST);
+    pool.start(1);
+    BlockTask::release = false;
+    Result blocker = pool.submitTask(std::make_shared<BlockTask>());
+    CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+    Result queued = pool.submitTask(std::make_shared<ValueTask>(1));
+    CHECK(queued.getStatus() == SubmitStatus::ACCEPTED);
+    //队列满了
+    Result full = pool.submitTask(std::make_shared<ValueTask>(2));
+    CHECK(full.getStatus() == SubmitStatus::QUEUE_FULL);
+    CHECK(full.getState() == ResultState::REJECTED);
+    CHECK(!full.get().hasValue());
+    //被移走的Result不对应任何任务
+    Result moved = std::move(queued);
+    CHECK(queued.getState() == ResultState::INVALID);
+    CHECK(!queued.get().hasValue());
+    std::thread releaser([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        BlockTask::release = true;
+    });
+    CHECK(pool.shutdown(ShutdownMode::CANCEL_PENDING) == 1);
+    releaser.join();
+    CHECK(!moved.get().hasValue());
+    CHECK(moved.getState() == ResultState::CANCELLED);
+    CHECK(moved.isCancelled());
+    CHECK(blocker.getState() == ResultState::OK);
+    //shutdown之后提交
+    Result late = pool.submitTask(std::make_shared<ValueTask>(3));
+    CHECK(late.getStatus() == SubmitStatus::SHUT_DOWN);
+    CHECK(late.getState() == ResultState::REJECTED);
+    CHECK(!late.get().hasValue());
+}
+}
+
+int main()
+{
+    testException();
+    testBadCast();
+    testStates();
+    return testResult();
+}
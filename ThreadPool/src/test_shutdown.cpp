@@ -0,0 +1,124 @@
+#include "threadpool.h"
+#include "test_check.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+/*
+三种shutdown方式
+1. DRAIN：队列里的任务全部执行完，返回0
+2. CANCEL_PENDING：只等正在执行的任务，排着的全部丢弃，返回丢弃的个数，它们的Result是CANCELLED
+3. DEADLINE：时间内排空就和DRAIN一样；排不空的话到时间就返回，剩下的按CANCEL_PENDING处理
+4. 只能关一次，第二次直接返回0
+*/
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+//丢弃的个数和CANCELLED的Result个数对得上，其余的都执行完了
+void checkCancelled(std::vector<Result>& results, int cancelled)
+{
+    int count = 0;
+    for (Result& r : results)
+    {
+        Any value = r.get();
+        if (r.getState() == ResultState::CANCELLED)
+        {
+            CHECK(!value.hasValue());
+            count++;
+        }
+        else
+        {
+            CHECK(r.getState() == ResultState::OK);
+        }
+    }
+    CHECK(count == cancelled);
+}
+
+void testDrain()
+{
+    ThreadPool pool;
+    pool.start(1);
+    std::vector<Result> results;
+    for (int i = 0; i < 20; i++)
+    {
+        results.push_back(pool.submitTask(std::make_shared<SleepTask>(std::chrono::milliseconds(2))));
+    }
+    CHECK(pool.shutdown(ShutdownMode::DRAIN) == 0);
+    CHECK(pool.stats().total.tasksExecuted == 20);
+    checkCancelled(results, 0);
+    //已经关了
+    CHECK(pool.shutdown(ShutdownMode::CANCEL_PENDING) == 0);
+}
+
+void testCancelPending()
+{
+    ThreadPool pool;
+    pool.start(1);
+    BlockTask::release = false;
+    Result blocker = pool.submitTask(std::make_shared<BlockTask>());
+    CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+    std::vector<Result> results;
+    for (int i = 0; i < 10; i++)
+    {
+        results.push_back(pool.submitTask(std::make_shared<SleepTask>()));
+    }
+    std::thread releaser([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        BlockTask::release = true;
+    });
+    //正在执行的blocker要等，排着的10个丢弃
+    CHECK(pool.shutdown(ShutdownMode::CANCEL_PENDING) == 10);
+    releaser.join();
+    CHECK(blocker.getState() == ResultState::OK);
+    checkCancelled(results, 10);
+    CHECK(pool.stats().total.tasksExecuted == 1);
+}
+
+void testDeadlineDrained()
+{
+    ThreadPool pool;
+    pool.start(1);
+    std::vector<Result> results;
+    for (int i = 0; i < 5; i++)
+    {
+        results.push_back(pool.submitTask(std::make_shared<SleepTask>(std::chrono::milliseconds(5))));
+    }
+    //时间够，排空就返回，不用等到deadline
+    Clock::time_point begin = Clock::now();
+    CHECK(pool.shutdown(ShutdownMode::DEADLINE, std::chrono::seconds(5)) == 0);
+    CHECK(Clock::now() - begin < std::chrono::seconds(2));
+    checkCancelled(results, 0);
+}
+
+void testDeadlineExpired()
+{
+    const int TASKS = 200;
+    ThreadPool pool;
+    pool.start(1);
+    std::vector<Result> results;
+    //一个一个执行要4s
+    for (int i = 0; i < TASKS; i++)
+    {
+        results.push_back(pool.submitTask(std::make_shared<SleepTask>(std::chrono::milliseconds(20))));
+    }
+    const std::chrono::milliseconds timeout(100);
+    Clock::time_point begin = Clock::now();
+    int cancelled = pool.shutdown(ShutdownMode::DEADLINE, timeout);
+    Clock::duration elapsed = Clock::now() - begin;
+    //到时间以后只等正在执行的那一个(20ms)，留出调度的余量
+    CHECK(elapsed >= timeout);
+    CHECK(elapsed < timeout + std::chrono::milliseconds(900));
+    CHECK(cancelled > 0 && cancelled < TASKS);
+    CHECK(pool.stats().total.tasksExecuted + cancelled == static_cast<uint64_t>(TASKS));
+    checkCancelled(results, cancelled);
+}
+}
+
+int main()
+{
+    testDrain();
+    testCancelPending();
+    testDeadlineDrained();
+    testDeadlineExpired();
+    return testResult();
+}
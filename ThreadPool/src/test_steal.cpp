@@ -0,0 +1,212 @@
+#include "threadpool.h"
+#include "test_check.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+/*
+Result::get()领走还在排队的任务自己执行(claimed_领取、stealsPending_、stolenTasks_)
+1. 工作线程和get()抢同一个任务，只有一个领到，任务只执行一次；线程池析构时还有线程在get()也一样
+2. get()领走的任务正在执行时shutdown，shutdown等它执行完才返回，不算取消
+3. 线程池已经析构，还在排队的任务被取消，之后的get()不会执行它，也不会再去找线程池
+*/
+namespace
+{
+//记下自己被执行了几次
+class CountTask : public Task
+{
+public:
+    Any run()
+    {
+        runs_++;
+        return 1;
+    }
+    int getRuns() const { return runs_; }
+private:
+    std::atomic_int runs_{0};
+};
+
+//执行开始和结束各置一个标志，中间睡time
+class PhaseTask : public Task
+{
+public:
+    explicit PhaseTask(std::chrono::milliseconds time) : time_(time) {}
+    Any run()
+    {
+        started_ = true;
+        std::this_thread::sleep_for(time_);
+        finished_ = true;
+        return 1;
+    }
+    bool isStarted() const { return started_; }
+    bool isFinished() const { return finished_; }
+private:
+    std::chrono::milliseconds time_;
+    std::atomic_bool started_{false};
+    std::atomic_bool finished_{false};
+};
+
+void testRaceRunsOnce()
+{
+    const int PRODUCERS = 2;
+    const int TASKS = 2000;
+    ThreadPool pool;
+    pool.start(2);
+    std::vector<std::shared_ptr<CountTask>> tasks[PRODUCERS];
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; p++)
+    {
+        producers.emplace_back([&, p]() {
+            for (int i = 0; i < TASKS; i++)
+            {
+                auto task = std::make_shared<CountTask>();
+                tasks[p].push_back(task);
+                Result r = pool.submitTask(task);
+                //有时让一下，工作线程先取到
+                if (i % 3 == 0)
+                {
+                    std::this_thread::yield();
+                }
+                CHECK(r.get().cast_<int>() == 1);
+            }
+        });
+    }
+    for (std::thread& t : producers)
+    {
+        t.join();
+    }
+    int wrong = 0;
+    for (auto& list : tasks)
+    {
+        for (auto& task : list)
+        {
+            wrong += task->getRuns() == 1 ? 0 : 1;
+        }
+    }
+    CHECK(wrong == 0);
+    //get()执行的也算在执行数里，每个任务只算一次
+    PoolStats stats = pool.stats();
+    CHECK(stats.total.tasksExecuted == static_cast<uint64_t>(PRODUCERS * TASKS));
+    CHECK(stats.steals <= static_cast<uint64_t>(PRODUCERS * TASKS));
+}
+
+void testDestroyWhileStealing()
+{
+    const int GETTERS = 4;
+    const int TASKS = 400;
+    for (int round = 0; round < 20; round++)
+    {
+        std::vector<std::shared_ptr<CountTask>> tasks;
+        std::vector<Result> results;
+        auto pool = std::make_unique<ThreadPool>();
+        pool->start(1);
+        for (int i = 0; i < TASKS; i++)
+        {
+            tasks.push_back(std::make_shared<CountTask>());
+            results.push_back(pool->submitTask(tasks.back()));
+        }
+        std::vector<std::thread> getters;
+        for (int g = 0; g < GETTERS; g++)
+        {
+            getters.emplace_back([&, g]() {
+                for (int i = g; i < TASKS; i += GETTERS)
+                {
+                    results[i].get();
+                }
+            });
+        }
+        if (round % 2 == 1)
+        {
+            pool->shutdown(ShutdownMode::CANCEL_PENDING);
+        }
+        pool.reset();
+        for (std::thread& t : getters)
+        {
+            t.join();
+        }
+        //执行过的正好一次，没执行的是被取消的
+        int wrong = 0;
+        for (int i = 0; i < TASKS; i++)
+        {
+            ResultState state = results[i].getState();
+            bool ok = (tasks[i]->getRuns() == 1 && state == ResultState::OK)
+                || (tasks[i]->getRuns() == 0 && state == ResultState::CANCELLED);
+            wrong += ok ? 0 : 1;
+        }
+        CHECK(wrong == 0);
+    }
+}
+
+void testShutdownWaitsForStolen()
+{
+    ThreadPool pool;
+    pool.start(1);
+    BlockTask::release = false;
+    Result blocker = pool.submitTask(std::make_shared<BlockTask>());
+    CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+    auto task = std::make_shared<PhaseTask>(std::chrono::milliseconds(200));
+    Result r = pool.submitTask(task);
+    //唯一的工作线程被占着，get()在这个线程里领走执行
+    std::thread getter([&]() { r.get(); });
+    CHECK(waitFor([&]() { return task->isStarted(); }));
+    CHECK(pool.stats().steals == 1);
+    BlockTask::release = true;
+    //领走的任务已经不在队列里，不算取消，shutdown要等它执行完
+    CHECK(pool.shutdown(ShutdownMode::CANCEL_PENDING) == 0);
+    CHECK(task->isFinished());
+    getter.join();
+    CHECK(r.getState() == ResultState::OK);
+    CHECK(pool.stats().total.tasksExecuted == 2);
+}
+
+void testGetAfterDestroy()
+{
+    //一直没有start的线程池，析构时把排着的任务取消
+    std::vector<std::shared_ptr<CountTask>> tasks;
+    std::vector<Result> results;
+    {
+        ThreadPool pool;
+        for (int i = 0; i < 3; i++)
+        {
+            tasks.push_back(std::make_shared<CountTask>());
+            results.push_back(pool.submitTask(tasks.back()));
+        }
+    }
+    //任务排在一个工作线程被占着的线程池里，shutdown(CANCEL_PENDING)之后析构
+    {
+        ThreadPool pool;
+        pool.start(1);
+        BlockTask::release = false;
+        Result blocker = pool.submitTask(std::make_shared<BlockTask>());
+        CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+        for (int i = 0; i < 3; i++)
+        {
+            tasks.push_back(std::make_shared<CountTask>());
+            results.push_back(pool.submitTask(tasks.back()));
+        }
+        std::thread releaser([]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            BlockTask::release = true;
+        });
+        CHECK(pool.shutdown(ShutdownMode::CANCEL_PENDING) == 3);
+        releaser.join();
+    }
+    //线程池已经没了，get()直接返回空值
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        CHECK(!results[i].get().hasValue());
+        CHECK(results[i].getState() == ResultState::CANCELLED);
+        CHECK(tasks[i]->getRuns() == 0);
+    }
+}
+}
+
+int main()
+{
+    testRaceRunsOnce();
+    testDestroyWhileStealing();
+    testShutdownWaitsForStolen();
+    testGetAfterDestroy();
+    return testResult();
+}
@@ -0,0 +1,152 @@
+#include "threadpool.h"
+#include "strand.h"
+#include "test_check.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+/*
+按key串行执行(Strand)
+1. 同一个key的任务按提交顺序执行，不会有两个同时执行
+2. 不同key之间并行
+3. drain任务还在排队时shutdown(CANCEL_PENDING)，这个key排着的任务全部取消，get()不会一直等
+*/
+namespace
+{
+const int KEYS = 4;
+const int TASKS_PER_KEY = 200;
+
+struct KeyState
+{
+    std::atomic_bool running{false};
+    std::atomic_int overlaps{0};
+    std::vector<int> order; //只在这个key的任务里写，Strand保证不会同时写
+};
+
+std::atomic_int concurrent{0};
+std::atomic_int maxConcurrent{0};
+
+class OrderTask : public Task
+{
+public:
+    OrderTask(KeyState& state, int seq)
+        : state_(state)
+        , seq_(seq)
+    {}
+    Any run()
+    {
+        if (state_.running.exchange(true))
+        {
+            state_.overlaps++;
+        }
+        int now = ++concurrent;
+        int max = maxConcurrent.load();
+        while (now > max && !maxConcurrent.compare_exchange_weak(max, now))
+        {
+        }
+        state_.order.push_back(seq_);
+        //睡一下，让别的key有机会同时执行
+        if (seq_ % 20 == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        concurrent--;
+        state_.running = false;
+        return seq_;
+    }
+private:
+    KeyState& state_;
+    int seq_;
+};
+
+void testOrderAndOverlap()
+{
+    ThreadPool pool;
+    pool.start(4);
+    KeyState states[KEYS];
+    //每个key一个生产者线程，同时提交
+    std::vector<std::thread> producers;
+    std::vector<std::vector<Result>> results(KEYS);
+    for (int key = 0; key < KEYS; key++)
+    {
+        producers.emplace_back([&, key]() {
+            for (int seq = 0; seq < TASKS_PER_KEY; seq++)
+            {
+                results[key].push_back(pool.submitKeyed(key, std::make_shared<OrderTask>(states[key], seq)));
+            }
+        });
+    }
+    for (std::thread& t : producers)
+    {
+        t.join();
+    }
+    for (int key = 0; key < KEYS; key++)
+    {
+        for (int seq = 0; seq < TASKS_PER_KEY; seq++)
+        {
+            CHECK(results[key][seq].get().cast_<int>() == seq);
+        }
+        CHECK(states[key].overlaps == 0);
+        CHECK(static_cast<int>(states[key].order.size()) == TASKS_PER_KEY);
+        bool ordered = true;
+        for (int seq = 0; seq < static_cast<int>(states[key].order.size()); seq++)
+        {
+            ordered = ordered && states[key].order[seq] == seq;
+        }
+        CHECK(ordered);
+        //最后一个任务的get()返回时drain可能还没减掉计数
+        std::shared_ptr<Strand> strand = pool.strand(key);
+        CHECK(waitFor([&]() { return strand->pending() == 0; }));
+    }
+    CHECK(maxConcurrent >= 2);
+}
+
+void testSameStrand()
+{
+    ThreadPool pool;
+    pool.start(1);
+    std::shared_ptr<Strand> a = pool.strand(7);
+    CHECK(pool.strand(7) == a);
+    CHECK(pool.strand(8) != a);
+}
+
+void testCancelPending()
+{
+    BlockTask::release = false;
+    ThreadPool pool;
+    pool.start(1);
+    Result blocker = pool.submitTask(std::make_shared<BlockTask>());
+    //唯一的线程在执行blocker，Strand的drain任务只能在队列里排着
+    CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+    KeyState state;
+    std::vector<Result> results;
+    for (int seq = 0; seq < 10; seq++)
+    {
+        results.push_back(pool.submitKeyed(1, std::make_shared<OrderTask>(state, seq)));
+    }
+    std::shared_ptr<Strand> strand = pool.strand(1);
+    CHECK(strand->pending() == 10);
+    std::thread releaser([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        BlockTask::release = true;
+    });
+    //一个drain任务被丢弃
+    CHECK(pool.shutdown(ShutdownMode::CANCEL_PENDING) == 1);
+    releaser.join();
+    for (Result& r : results)
+    {
+        CHECK(!r.get().hasValue());
+        CHECK(r.isCancelled());
+    }
+    CHECK(state.order.empty());
+    CHECK(strand->pending() == 0);
+}
+}
+
+int main()
+{
+    testOrderAndOverlap();
+    testSameStrand();
+    testCancelPending();
+    return testResult();
+}
@@ -0,0 +1,137 @@
+#include "threadpool.h"
+#include "token_bucket.h"
+#include "test_check.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+/*
+令牌桶和按提交类别限速
+1. 一开始能连续拿burst个令牌，之后按rate补，rate <= 0不限速
+2. 多个线程同时抢，拿到的令牌数不会超过桶里的
+3. submitTask：没有令牌返回RATE_LIMITED，waitForToken的等到令牌再提交，没有设置类别的任务不受影响
+*/
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+class NopTask : public Task
+{
+public:
+    Any run() { return 0; }
+};
+
+void testBurstAndRefill()
+{
+    TokenBucket bucket(20, 5);
+    for (int i = 0; i < 5; i++)
+    {
+        CHECK(bucket.tryAcquire());
+    }
+    CHECK(!bucket.tryAcquire());
+    //20个/s，50ms补一个
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    CHECK(bucket.tryAcquire());
+    CHECK(!bucket.tryAcquire());
+
+    TokenBucket unlimited(0, 1);
+    for (int i = 0; i < 1000; i++)
+    {
+        CHECK(unlimited.tryAcquire());
+    }
+    //运行期间改成不限速
+    bucket.setRate(0, 1);
+    CHECK(bucket.tryAcquire());
+}
+
+void testAcquireWaits()
+{
+    TokenBucket bucket(50, 1);
+    CHECK(bucket.acquire() == std::chrono::nanoseconds(0));
+    //下一个令牌要20ms以后
+    auto begin = Clock::now();
+    std::chrono::nanoseconds waited = bucket.acquire();
+    CHECK(waited > std::chrono::milliseconds(10));
+    CHECK(Clock::now() - begin >= waited);
+}
+
+void testConcurrent()
+{
+    //补得很慢，测试期间只能拿到一开始的100个
+    TokenBucket bucket(0.001, 100);
+    std::atomic_int acquired{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 1000; i++)
+            {
+                if (bucket.tryAcquire())
+                {
+                    acquired++;
+                }
+            }
+        });
+    }
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+    CHECK(acquired == 100);
+}
+
+void testSubmitClass()
+{
+    ThreadPool pool;
+    pool.start(1);
+    SubmitClass* background = pool.defineSubmitClass("background", 10, 3);
+    CHECK(background != nullptr);
+    CHECK(pool.getSubmitClass("background") == background);
+    CHECK(pool.getSubmitClass("missing") == nullptr);
+
+    std::vector<Result> results;
+    for (int i = 0; i < 3; i++)
+    {
+        auto task = std::make_shared<NopTask>();
+        task->setSubmitClass(background);
+        results.push_back(pool.submitTask(task));
+        CHECK(results.back().getStatus() == SubmitStatus::ACCEPTED);
+    }
+    auto limited = std::make_shared<NopTask>();
+    limited->setSubmitClass(background);
+    Result r = pool.submitTask(limited);
+    CHECK(r.getStatus() == SubmitStatus::RATE_LIMITED);
+    CHECK(r.getState() == ResultState::REJECTED);
+    //其他任务不受这个类别限速
+    Result other = pool.submitTask(std::make_shared<NopTask>());
+    CHECK(other.getStatus() == SubmitStatus::ACCEPTED);
+
+    //等令牌：10个/s，大约100ms
+    auto waiting = std::make_shared<NopTask>();
+    waiting->setSubmitClass(background, true);
+    auto begin = Clock::now();
+    Result waited = pool.submitTask(waiting);
+    CHECK(waited.getStatus() == SubmitStatus::ACCEPTED);
+    CHECK(Clock::now() - begin >= std::chrono::milliseconds(50));
+
+    CHECK(background->getAdmitted() == 4);
+    CHECK(background->getRejected() == 1);
+    CHECK(background->getWaited() == 1);
+    CHECK(pool.stats().rejected == 0);
+
+    //同名再定义一次是改限速
+    CHECK(pool.defineSubmitClass("background", 0, 1) == background);
+    auto unlimited = std::make_shared<NopTask>();
+    unlimited->setSubmitClass(background);
+    CHECK(pool.submitTask(unlimited).getStatus() == SubmitStatus::ACCEPTED);
+}
+}
+
+int main()
+{
+    testBurstAndRefill();
+    testAcquireWaits();
+    testConcurrent();
+    testSubmitClass();
+    return testResult();
+}
@@ -0,0 +1,110 @@
+#include "threadpool.h"
+#include "test_check.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+/*
+watchdog的软超时检测
+1. 超过自己timeout的任务报告一次，名字、线程、已经执行的时间都对
+2. 没有超时、没设timeout的任务不报告
+3. cached模式开了补偿：被卡住的线程之外再加一个线程，后面的任务不会被堵住
+*/
+namespace
+{
+class FlagTask : public Task
+{
+public:
+    explicit FlagTask(std::atomic_bool& done) : done_(done) {}
+    Any run()
+    {
+        done_ = true;
+        return 0;
+    }
+private:
+    std::atomic_bool& done_;
+};
+
+struct Reports
+{
+    std::mutex mtx;
+    std::vector<ThreadPool::StuckTask> tasks;
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return tasks.size();
+    }
+};
+
+void testReport()
+{
+    Reports reports;
+    ThreadPool pool;
+    pool.setStuckTaskHandler([&](const ThreadPool::StuckTask& task) {
+        std::lock_guard<std::mutex> lock(reports.mtx);
+        reports.tasks.push_back(task);
+    });
+    pool.start(2);
+    auto slow = std::make_shared<SleepTask>(std::chrono::milliseconds(400));
+    slow->setName("slow");
+    slow->setTimeout(std::chrono::milliseconds(50));
+    auto fast = std::make_shared<SleepTask>(std::chrono::milliseconds(10));
+    fast->setName("fast");
+    fast->setTimeout(std::chrono::milliseconds(300));
+    Result r1 = pool.submitTask(slow);
+    Result r2 = pool.submitTask(fast);
+    //没设timeout的任务执行多久都不检查
+    Result r3 = pool.submitTask(std::make_shared<SleepTask>(std::chrono::milliseconds(400)));
+    r1.get();
+    r2.get();
+    r3.get();
+    std::lock_guard<std::mutex> lock(reports.mtx);
+    //同一个任务只报告一次
+    CHECK(reports.tasks.size() == 1);
+    if (!reports.tasks.empty())
+    {
+        const ThreadPool::StuckTask& task = reports.tasks.front();
+        CHECK(task.name != nullptr && std::strcmp(task.name, "slow") == 0);
+        CHECK(task.timeout == std::chrono::milliseconds(50));
+        CHECK(task.duration >= std::chrono::milliseconds(50));
+    }
+    CHECK(pool.stats().stuckTasks == 1);
+}
+
+void testCompensation()
+{
+    Reports reports;
+    BlockTask::release = false;
+    ThreadPool pool;
+    pool.setMode(PoolMode::MODE_CACHED);
+    pool.setStuckTaskHandler([&](const ThreadPool::StuckTask& task) {
+        std::lock_guard<std::mutex> lock(reports.mtx);
+        reports.tasks.push_back(task);
+    });
+    pool.setStuckCompensation(true);
+    pool.start(1);
+    auto stuck = std::make_shared<BlockTask>();
+    stuck->setTimeout(std::chrono::milliseconds(50));
+    Result r1 = pool.submitTask(stuck);
+    CHECK(waitFor([&]() { return reports.size() == 1; }));
+    //执行任务的是工作线程
+    CHECK(reports.tasks.empty() || reports.tasks.front().threadId >= 0);
+    CHECK(waitFor([&]() { return pool.getCurThreadSize() >= 2; }));
+    //不调用get()：get()会在调用者线程里执行还在排队的任务，看不出补上的线程有没有在工作
+    std::atomic_bool done{false};
+    Result r2 = pool.submitTask(std::make_shared<FlagTask>(done));
+    CHECK(waitFor([&]() { return done.load(); }));
+    BlockTask::release = true;
+    r1.get();
+    r2.get();
+}
+}
+
+int main()
+{
+    testReport();
+    testCompensation();
+    return testResult();
+}
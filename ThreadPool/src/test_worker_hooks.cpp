@@ -0,0 +1,186 @@
+#include "threadpool.h"
+#include "test_check.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+/*
+工作线程的生命周期hook和上下文
+1. 每个线程先调用onWorkerStart，再执行任务，最后一个任务执行完才调用onWorkerStop，start和stop一一对应
+2. 任务里currentWorker()是执行它的线程的上下文，start里放进去的资源每个线程只创建一次
+3. 不是工作线程返回nullptr；没有hook的线程池get()在调用者线程执行任务时，是threadId为-1的空上下文
+*/
+namespace
+{
+struct EventLog
+{
+    std::mutex mtx;
+    std::map<int, std::vector<std::string>> events; //线程id -> 按发生顺序的事件
+    void add(int threadId, const std::string& event)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        events[threadId].push_back(event);
+    }
+};
+
+//每个线程一份的资源
+struct Scratch
+{
+    int owner = -1;
+    int used = 0;
+};
+
+std::atomic_int scratchCreated{0};
+
+class HookedTask : public Task
+{
+public:
+    explicit HookedTask(EventLog& log) : log_(log) {}
+    Any run()
+    {
+        WorkerContext* worker = ThreadPool::currentWorker();
+        if (worker == nullptr)
+        {
+            return -1;
+        }
+        Scratch* scratch = worker->get<Scratch>();
+        //类型不对拿不到
+        if (scratch == nullptr || worker->get<int>() != nullptr || scratch->owner != worker->getThreadId())
+        {
+            return -1;
+        }
+        scratch->used++;
+        log_.add(worker->getThreadId(), "task");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return worker->getThreadId();
+    }
+private:
+    EventLog& log_;
+};
+
+class ContextTask : public Task
+{
+public:
+    Any run()
+    {
+        WorkerContext* worker = ThreadPool::currentWorker();
+        return worker == nullptr ? -2 : worker->getThreadId();
+    }
+};
+
+void testHookOrder()
+{
+    const int THREADS = 3;
+    const int TASKS = 60;
+    EventLog log;
+    std::atomic_int stopUsed{0};
+    {
+        ThreadPool pool;
+        pool.onWorkerStart([&](WorkerContext& context) {
+            auto scratch = std::make_shared<Scratch>();
+            scratch->owner = context.getThreadId();
+            context.set(scratch);
+            scratchCreated++;
+            log.add(context.getThreadId(), "start");
+        });
+        pool.onWorkerStop([&](WorkerContext& context) {
+            Scratch* scratch = context.get<Scratch>();
+            stopUsed += scratch == nullptr ? 0 : scratch->used;
+            log.add(context.getThreadId(), "stop");
+        });
+        pool.start(THREADS);
+        std::vector<Result> results;
+        for (int i = 0; i < TASKS; i++)
+        {
+            results.push_back(pool.submitTask(std::make_shared<HookedTask>(log)));
+        }
+        for (Result& r : results)
+        {
+            //有hook的线程池get()不在调用者线程执行，任务都在工作线程里
+            CHECK(r.get().cast_<int>() >= 0);
+        }
+        CHECK(pool.stats().steals == 0);
+        //提交线程不是工作线程
+        CHECK(ThreadPool::currentWorker() == nullptr);
+    }
+    //资源每个线程创建一次，不是每个任务
+    CHECK(scratchCreated == THREADS);
+    CHECK(stopUsed == TASKS);
+    std::lock_guard<std::mutex> lock(log.mtx);
+    CHECK(log.events.size() == static_cast<size_t>(THREADS));
+    int tasks = 0;
+    for (auto& item : log.events)
+    {
+        std::vector<std::string>& events = item.second;
+        CHECK(events.size() >= 2);
+        CHECK(events.front() == "start");
+        CHECK(events.back() == "stop");
+        for (size_t i = 1; i + 1 < events.size(); i++)
+        {
+            CHECK(events[i] == "task");
+            tasks++;
+        }
+    }
+    CHECK(tasks == TASKS);
+}
+
+//cached模式后来加的线程也调用hook
+void testCachedThreads()
+{
+    std::atomic_int started{0};
+    std::atomic_int stopped{0};
+    {
+        ThreadPool pool;
+        pool.setMode(PoolMode::MODE_CACHED);
+        pool.onWorkerStart([&](WorkerContext&) { started++; });
+        pool.onWorkerStop([&](WorkerContext&) { stopped++; });
+        pool.start(1);
+        BlockTask::release = false;
+        std::vector<Result> results;
+        for (int i = 0; i < 4; i++)
+        {
+            results.push_back(pool.submitTask(std::make_shared<BlockTask>()));
+        }
+        CHECK(waitFor([&]() { return pool.getCurThreadSize() >= 2; }));
+        BlockTask::release = true;
+        for (Result& r : results)
+        {
+            r.get();
+        }
+        CHECK(started >= 2);
+    }
+    CHECK(started == stopped);
+}
+
+void testInlineContext()
+{
+    ThreadPool pool;
+    pool.start(1);
+    BlockTask::release = false;
+    Result blocker = pool.submitTask(std::make_shared<BlockTask>());
+    CHECK(waitFor([&]() { return pool.stats().queueDepth == 0; }));
+    //还在排队，get()在这个线程里执行它
+    Result r = pool.submitTask(std::make_shared<ContextTask>());
+    CHECK(r.get().cast_<int>() == -1);
+    CHECK(pool.stats().steals == 1);
+    //执行完恢复成原来的(不是工作线程)
+    CHECK(ThreadPool::currentWorker() == nullptr);
+    BlockTask::release = true;
+    blocker.get();
+    //工作线程执行的任务拿到的是自己的上下文
+    Result onWorker = pool.submitTask(std::make_shared<ContextTask>());
+    CHECK(waitFor([&]() { return pool.stats().total.tasksExecuted == 3; }));
+    CHECK(onWorker.get().cast_<int>() >= 0);
+}
+}
+
+int main()
+{
+    testHookOrder();
+    testCachedThreads();
+    testInlineContext();
+    return testResult();
+}
@@ -0,0 +1,110 @@
+#include "thread_budget.h"
+#include "cpu_quota.h"
+#include <algorithm>
+
+ThreadBudget::ThreadBudget(int total)
+    : total_(std::max(total, 1))
+    , reserved_(0)
+    , committed_(0)
+{}
+
+ThreadBudget& ThreadBudget::global()
+{
+    static ThreadBudget budget(CpuQuota::effectiveCpuCount());
+    return budget;
+}
+
+int ThreadBudget::charged(const Member& member)
+{
+    return std::max(member.threads, member.minThreads);
+}
+
+int ThreadBudget::join(const std::string& name, int minThreads, int maxThreads)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    minThreads = std::max(minThreads, 0);
+    maxThreads = std::max(maxThreads, minThreads);
+    //预留的min必须真的拿得到：已经借出去的线程还回来之前，min之和也不能超过余量
+    if (reserved_ + minThreads > total_ || committed_ + minThreads > total_)
+    {
+        return -1;
+    }
+    members_.push_back(Member{name, minThreads, maxThreads, 0, true});
+    reserved_ += minThreads;
+    committed_ += minThreads;
+    return static_cast<int>(members_.size() - 1);
+}
+
+void ThreadBudget::leave(int member)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (member < 0 || member >= static_cast<int>(members_.size()) || !members_[member].joined)
+    {
+        return;
+    }
+    Member& m = members_[member];
+    committed_ -= charged(m);
+    reserved_ -= m.minThreads;
+    m.threads = 0;
+    m.joined = false;
+}
+
+int ThreadBudget::acquire(int member, int size)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (member < 0 || member >= static_cast<int>(members_.size()) || !members_[member].joined)
+    {
+        return 0;
+    }
+    Member& m = members_[member];
+    int granted = 0;
+    while (granted < size && m.threads < m.maxThreads)
+    {
+        if (m.threads >= m.minThreads)
+        {
+            //预留的用完了，从公共余量里借
+            if (committed_ >= total_)
+            {
+                break;
+            }
+            committed_++;
+        }
+        m.threads++;
+        granted++;
+    }
+    return granted;
+}
+
+void ThreadBudget::release(int member, int size)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (member < 0 || member >= static_cast<int>(members_.size()) || !members_[member].joined)
+    {
+        return;
+    }
+    Member& m = members_[member];
+    committed_ -= charged(m);
+    m.threads = std::max(m.threads - size, 0);
+    committed_ += charged(m);
+}
+
+int ThreadBudget::getTotal() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return total_;
+}
+
+std::vector<BudgetMemberStats> ThreadBudget::stats() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<BudgetMemberStats> result;
+    for (size_t i = 0; i < members_.size(); i++)
+    {
+        const Member& m = members_[i];
+        if (m.joined)
+        {
+            result.push_back(BudgetMemberStats{static_cast<int>(i), m.name, m.minThreads, m.maxThreads, m.threads});
+        }
+    }
+    return result;
+}
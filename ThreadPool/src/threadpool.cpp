@@ -1,72 +1,586 @@
 #include "threadpool.h"
+#include "cpu_quota.h"
+#include "trace.h"
 #include <functional>
 #include <thread>
 #include <iostream>
+#include <algorithm>
 const int TASK_MAX_THRESHOLD = INT32_MAX;//最大任务数量2147483647
 const int THREAD_MAX_THRESHOLD =  100;//最大线程数量
+const int INIT_THREAD_SIZE = 4;//没有setInitThreadSize、start也没给参数时的初始线程数
 const int THREAD_MAX_IDLE_TIME =  60;//线程最大空闲时间(s)
+const int AUTO_THREAD_FACTOR = 2;//自动模式下cached线程上限 = 可用CPU数 * 2
+const auto CPU_QUOTA_CHECK_INTERVAL = std::chrono::seconds(5);//重新读取CPU配额的周期
+const auto THREAD_CONTROL_INTERVAL = std::chrono::milliseconds(100);//自适应模式采样吞吐量的周期
+const auto WATCHDOG_CHECK_INTERVAL = std::chrono::milliseconds(100);//watchdog检查超时任务的周期
+const auto BUDGET_RETRY_INTERVAL = std::chrono::milliseconds(10);//线程预算不够时重新申请的周期
 
 //=============================线程池================================
 //线程池构造
 //锁不要初始化
 ThreadPool::ThreadPool()
-    : initThreadSize_(0)
-    , taskSize_(0) 
-    , idleThreadSize_(0) //空闲线程
-    , curThreadSize_(0) 
+    : initThreadSize_(INIT_THREAD_SIZE)
     , threadSizeThreshold_(THREAD_MAX_THRESHOLD) //线程最大上限
+    , curThreadSize_(0) 
+    , idleThreadSize_(0) //空闲线程
+    , retireThreadSize_(0)
+    , taskSize_(0) 
     , taskQueMaxThreshold_  (TASK_MAX_THRESHOLD)//不要在代码中出现除了0/1的数字，数字要用变量代替
     , poolMode_(PoolMode::MODE_FIXED) 
     , isPoolRunning_(false) 
-    {}
+    , isShutdown_(false)
+    , budget_(nullptr)
+    , budgetMember_(-1)
+    , budgetDeficit_(0)
+    , autoSize_(false)
+    , cpuCount_(0)
+    , growThreadSize_(0)
+    , reserveThreadSize_(0)
+    , spareThreadSize_(0)
+    , spareActivateSize_(0)
+    , threadMaxIdleTime_(THREAD_MAX_IDLE_TIME)
+    , supervisorReschedule_(false)
+    , hibernateTime_(0)
+    , hibernating_(false)
+    , supervisorExited_(false)
+    , hibernateStat_{0, 0, std::chrono::nanoseconds(0), std::chrono::nanoseconds(0)}
+    , adaptive_(false)
+    , completedTaskSize_(0)
+    , maxQueueDepth_(0)
+    , rejectPolicy_(RejectPolicy::BLOCK_TIMEOUT)
+    , rejectTimeout_(std::chrono::seconds(1))
+    , blockedSize_(0)
+    , droppedSize_(0)
+    , admissionTarget_(0)
+    , admissionInterval_(0)
+    , overloaded_(false)
+    , shedSize_(0)
+    , stuckCompensation_(false)
+    , stuckTaskSize_(0)
+    , lockAcquired_(0)
+    , lockContended_(0)
+    , stealsPending_(0)
+    {
+        counters_.rejected = 0;
+        counters_.steals = 0;
+        counters_.callerRuns = 0;
+        publishConfig();
+    }
 
 //线程池的析构,在C++工程中，有资源的分配，就有资源的析构
+//析构时队列里的任务都要执行完，已经调用过shutdown的话这里直接返回
 ThreadPool::~ThreadPool()
 {
+    shutdown(ShutdownMode::DRAIN);
+}
+
+int ThreadPool::shutdown(ShutdownMode mode, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    if (isShutdown_)
+    {
+        return 0;
+    }
+    isShutdown_ = true;
+    //阻塞在队列满上的提交者不用再等了
+    notFull_.notify_all();
+    //等队列排空：每取走一个任务都会通知notFull_
+    if (mode == ShutdownMode::DEADLINE)
+    {
+        notFull_.wait_for(lock, timeout, [&]()->bool { return taskQue_.empty(); });
+    }
+    //丢弃还没开始的任务，唤醒在Result::get()上等待的用户线程
+    int cancelled = 0;
+    if (mode != ShutdownMode::DRAIN)
+    {
+        while (!taskQue_.empty())
+        {
+            std::shared_ptr<Task> task = taskQue_.popOldest();
+            taskSize_--;
+            //已经被Result::get()领走执行的不算
+            if (task->claim())
+            {
+                task->cancel();
+                cancelled++;
+            }
+            else
+            {
+                stealsPending_++;
+            }
+        }
+    }
+    //先让管理线程退出，避免它在关闭过程中继续创建线程
     isPoolRunning_ = false;
-    //等待线程池的线程返回, 有两种状态：阻塞  & 正在执行任务中
-    std::unique_lock<std::mutex> lock(taskQueMtx_);
-    notEmpty_.notify_all();//通知notEmpty_.wait从等待进入阻塞
-    //?为什么有1个线程未被回收， 检查线程队列还有线程，所以一直等
-    //size = 0, 资源回收完了，向下走
-    exitCond_.wait(lock,  [&]()->bool{return threads_.size() == 0;}); //当 threads_.size() != 0 线程进入阻塞状态，释放锁；否则往下执行
+    supervisorCond_.notify_all();
+    lock.unlock();
+    if (supervisor_.joinable())
+    {
+        supervisor_.join();
+    }
+    //线程有两种状态：阻塞 & 正在执行任务中。阻塞的叫醒后发现线程池关闭就退出，执行任务的执行完(DRAIN模式还要把队列取空)再退出
+    //线程对象只由join它的线程删除，现在管理线程已经退出，这些指针在join完之前一直有效
+    lock.lock();
+    notEmpty_.notify_all();
+    spareCond_.notify_all();//挂起的备用线程也要退出
+    std::vector<Thread*> threads;
+    for (auto& item : threads_)
+    {
+        threads.push_back(item.second.get());
+    }
+    for (auto& thread : exitedThreads_)
+    {
+        threads.push_back(thread.get());
+    }
+    lock.unlock();
+    for (Thread* thread : threads)
+    {
+        thread->join();
+    }
+    lock.lock();
+    exitedThreads_.clear();
+    //没有线程执行的任务(一直没有start、线程数为0)不会再有人执行，取消掉，get()不会一直等，也不会领到它再来找线程池
+    while (!taskQue_.empty())
+    {
+        std::shared_ptr<Task> task = taskQue_.popOldest();
+        taskSize_--;
+        if (task->claim())
+        {
+            task->cancel();
+            cancelled++;
+        }
+        else
+        {
+            stealsPending_++;
+        }
+    }
+    //Result::get()领走的任务还要回来拿锁、记统计，等它们执行完线程池才能析构
+    notFull_.wait(lock, [&]()->bool { return stealsPending_ == 0 && stolenTasks_.empty(); });
+    if (budget_ != nullptr)
+    {
+        budget_->leave(budgetMember_);
+    }
+    return cancelled;
 }
 
 
 //线程池的工作模式
-void ThreadPool::setMode(PoolMode mode)
+bool ThreadPool::setMode(PoolMode mode)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    PoolConfig config = *config_; //持锁时config_和成员变量一致
+    config.mode = mode;
+    return applyConfig(lock, config);
+}
+//设置task任务队列上限的阈值
+bool ThreadPool::setTaskQueMaxThreshold(int threshold)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    PoolConfig config = *config_;
+    config.taskQueMaxThreshold = threshold;
+    return applyConfig(lock, config);
+}
+
+bool ThreadPool::reconfigure(const PoolConfig& config)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    return applyConfig(lock, config);
+}
+
+PoolConfig ThreadPool::getConfig() const
+{
+    return *std::atomic_load(&config_);
+}
+
+//工作线程和提交者都是持锁读这些成员的，这里持锁改完再放锁，它们看到的要么全是旧的要么全是新的
+bool ThreadPool::applyConfig(std::unique_lock<std::mutex>& lock, const PoolConfig& config)
+{
+    //从预算借线程的线程池允许min为0，其他的至少要有一个线程
+    int minInit = budget_ != nullptr ? 0 : 1;
+    if (config.initThreadSize < minInit
+        || config.threadSizeThreshold < config.initThreadSize
+        || config.threadSizeThreshold <= 0
+        || config.taskQueMaxThreshold <= 0
+        || config.threadMaxIdleTime <= 0)
+    {
+        return false;
+    }
+    poolMode_ = config.mode;
+    initThreadSize_ = config.initThreadSize;
+    threadSizeThreshold_ = config.threadSizeThreshold;
+    taskQueMaxThreshold_ = config.taskQueMaxThreshold;
+    threadMaxIdleTime_ = config.threadMaxIdleTime;
+    //队列上限调大了，等着的提交者可以接着放
+    notFull_.notify_all();
+    //空闲线程重新判断：fixed/cached切换后要不要排进idleThreads_，线程多了要领退出名额
+    notEmpty_.notify_all();
+    //空闲回收的期限、要不要按吞吐量调整都变了
+    supervisorReschedule_ = true;
+    supervisorCond_.notify_one();
+    publishConfig();
+    //休眠中不用管线程数，唤醒时会按新的initThreadSize创建
+    if (isPoolRunning_ && !isShutdown_ && !hibernating_)
+    {
+        startSupervisor();
+        resizeThreads(lock);
+    }
+    return true;
+}
+
+void ThreadPool::publishConfig()
+{
+    auto config = std::make_shared<const PoolConfig>(PoolConfig{poolMode_, static_cast<int>(initThreadSize_),
+        threadSizeThreshold_, taskQueMaxThreshold_, threadMaxIdleTime_});
+    std::atomic_store(&config_, std::shared_ptr<const PoolConfig>(std::move(config)));
+}
+
+void ThreadPool::setRejectPolicy(RejectPolicy policy, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    rejectPolicy_ = policy;
+    rejectTimeout_ = timeout; //已经在notFull_上等着的提交者还按原来的策略等
+}
+
+void ThreadPool::setAdmissionControl(std::chrono::milliseconds target, std::chrono::milliseconds interval)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    admissionTarget_ = target;
+    admissionInterval_ = interval;
+    firstAboveTime_ = std::chrono::steady_clock::time_point();
+    overloaded_ = false;
+}
+
+std::shared_ptr<Strand> ThreadPool::strand(uint64_t key)
+{
+    StrandShard& shard = strandShards_[std::hash<uint64_t>()(key) % STRAND_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    std::weak_ptr<Strand>& entry = shard.strands[key];
+    std::shared_ptr<Strand> strand = entry.lock();
+    if (strand != nullptr)
+    {
+        return strand;
+    }
+    //原来的Strand已经释放，说明它的任务都执行完了，新建一个不会打乱顺序
+    strand = std::make_shared<Strand>(*this);
+    entry = strand;
+    if (shard.strands.size() >= shard.pruneSize)
+    {
+        for (auto it = shard.strands.begin(); it != shard.strands.end();)
+        {
+            if (it->second.expired())
+            {
+                it = shard.strands.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        shard.pruneSize = std::max<size_t>(64, shard.strands.size() * 2);
+    }
+    return strand;
+}
+
+Result ThreadPool::submitKeyed(uint64_t key, std::shared_ptr<Task> sp)
+{
+    return strand(key)->submitTask(std::move(sp));
+}
+
+bool ThreadPool::requeue(std::shared_ptr<Task> sp)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    if (isShutdown_)
+    {
+        return false;
+    }
+    if (hibernating_)
+    {
+        wakeUp();
+    }
+    sp->enqueueTime_ = std::chrono::steady_clock::now();
+    taskQue_.push(sp, sp->tenant_);
+    taskSize_++;
+    maxQueueDepth_ = std::max(maxQueueDepth_, static_cast<int>(taskQue_.size()));
+    notEmpty_.notify_one();
+    return true;
+}
+
+int ThreadPool::registerTenant(const std::string& name, int weight)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    return taskQue_.addTenant(name, weight);
+}
+
+bool ThreadPool::setTenantWeight(int tenant, int weight)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    return taskQue_.setWeight(tenant, weight);
+}
+
+SubmitClass* ThreadPool::defineSubmitClass(const std::string& name, double rate, double burst)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    std::unique_ptr<SubmitClass>& submitClass = submitClasses_[name];
+    if (submitClass == nullptr)
+    {
+        submitClass = std::make_unique<SubmitClass>(name, rate, burst);
+    }
+    else
+    {
+        submitClass->setRate(rate, burst);
+    }
+    return submitClass.get();
+}
+
+SubmitClass* ThreadPool::getSubmitClass(const std::string& name)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    auto it = submitClasses_.find(name);
+    return it == submitClasses_.end() ? nullptr : it->second.get();
+}
+
+//CoDel：看的是一段时间里排队时间的最小值，偶尔一个突发把队列堆高不算过载，
+//只有interval里所有任务都排了超过target(队列一直排不空，形成了"站着的队列")才算
+//这个任务取走后队列空了，说明队列已经排空，和CoDel一样直接解除过载：
+//否则队列排空以后(只有LOW任务在提交，或者一段时间没有任务)不会再有任务出队，过载状态就一直清不掉
+bool ThreadPool::updateAdmission(std::chrono::steady_clock::duration sojourn, std::chrono::steady_clock::time_point now)
+{
+    if (admissionTarget_.count() == 0)
+    {
+        return false;
+    }
+    if (sojourn < admissionTarget_ || taskQue_.empty())
+    {
+        firstAboveTime_ = std::chrono::steady_clock::time_point();
+        overloaded_ = false;
+    }
+    else if (firstAboveTime_ == std::chrono::steady_clock::time_point())
+    {
+        firstAboveTime_ = now;
+    }
+    else if (now - firstAboveTime_ >= admissionInterval_)
+    {
+        overloaded_ = true;
+    }
+    return overloaded_;
+}
+
+//设置线程池cached模式下线程阈值
+bool ThreadPool::setThreadSizeThreshold(int threshold)
+{
+    //fixed模式用不到上限，也先记下来，切到cached模式时用
+    std::unique_lock<std::mutex> lock = lockQueue();
+    PoolConfig config = *config_;
+    config.threadSizeThreshold = threshold;
+    return applyConfig(lock, config);
+}
+bool ThreadPool::setInitThreadSize(int size)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    PoolConfig config = *config_;
+    config.initThreadSize = size;
+    return applyConfig(lock, config);
+}
+
+bool ThreadPool::setThreadBudget(ThreadBudget& budget, const std::string& name, int minThreads, int maxThreads)
+{
+    if (checkRunningState() || budget_ != nullptr)
+    {
+        return false;
+    }
+    int member = budget.join(name, minThreads, maxThreads);
+    if (member < 0)
+    {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock = lockQueue();
+    budget_ = &budget;
+    budgetMember_ = member;
+    initThreadSize_ = std::max(minThreads, 0);
+    threadSizeThreshold_ = std::max(maxThreads, minThreads);
+    publishConfig();
+    return true;
+}
+
+namespace
+{
+//全局线程池的空闲线程早点还给预算，别的线程池才借得到
+const int GLOBAL_THREAD_MAX_IDLE_TIME = 10;
+
+struct GlobalPool
+{
+    GlobalPool()
+    {
+        ThreadBudget& budget = ThreadBudget::global();
+        pool.setMode(PoolMode::MODE_CACHED);
+        pool.setThreadMaxIdleTime(GLOBAL_THREAD_MAX_IDLE_TIME);
+        pool.setThreadBudget(budget, "global", 1, budget.getTotal());
+        pool.start();
+    }
+    ThreadPool pool;
+};
+}
+
+ThreadPool& ThreadPool::global()
+{
+    //ThreadBudget::global()在GlobalPool构造时先构造完，所以析构在线程池之后
+    static GlobalPool global;
+    return global.pool;
+}
+
+int ThreadPool::acquireThreads(int size)
+{
+    if (budget_ == nullptr || size <= 0)
+    {
+        return size;
+    }
+    return budget_->acquire(budgetMember_, size);
+}
+
+void ThreadPool::setAutoSize(bool enable)
 {
     if (checkRunningState())
     {
         return;
     }
-    poolMode_ =  mode;
+    autoSize_ = enable;
 }
-//设置task任务队列上限的阈值
-void ThreadPool::setTaskQueMaxThreshold(int threshold)
+
+void ThreadPool::setAdaptive(bool enable)
 {
     if (checkRunningState())
     {
         return;
     }
-    threadSizeThreshold_ = threshold;
+    adaptive_ = enable;
 }
 
-//设置线程池cached模式下线程阈值
-void ThreadPool::setThreadSizeThreshold(int threshold)
+void ThreadPool::setReserveThreadSize(int size)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    reserveThreadSize_ = size;
+    supervisorCond_.notify_one();
+}
+
+bool ThreadPool::setThreadMaxIdleTime(int seconds)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    PoolConfig config = *config_;
+    config.threadMaxIdleTime = seconds;
+    //期限变了，applyConfig会让管理线程重新算
+    return applyConfig(lock, config);
+}
+
+void ThreadPool::setHibernateTime(int seconds)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    hibernateTime_ = seconds;
+    supervisorReschedule_ = true;
+    supervisorCond_.notify_one();
+    //运行期间才打开休眠，管理线程可能还没启动
+    if (isPoolRunning_ && !isShutdown_ && !hibernating_)
+    {
+        startSupervisor();
+    }
+}
+
+void ThreadPool::setStuckTaskHandler(std::function<void(const StuckTask&)> handler)
 {
     if (checkRunningState())
     {
         return;
     }
-    if (poolMode_ == PoolMode::MODE_CACHED)
+    stuckTaskHandler_ = std::move(handler);
+}
+
+void ThreadPool::onWorkerStart(std::function<void(WorkerContext&)> hook)
+{
+    if (checkRunningState())
     {
-        threadSizeThreshold_ = threshold;
+        return;
     }
+    workerStartHook_ = std::move(hook);
 }
-void ThreadPool::setInitThreadSize(int size)
+
+void ThreadPool::onWorkerStop(std::function<void(WorkerContext&)> hook)
 {
-    
+    if (checkRunningState())
+    {
+        return;
+    }
+    workerStopHook_ = std::move(hook);
+}
+
+namespace
+{
+thread_local WorkerContext* currentWorkerContext = nullptr;
+}
+
+WorkerContext* ThreadPool::currentWorker()
+{
+    return currentWorkerContext;
+}
+
+void ThreadPool::setStuckCompensation(bool enable)
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    stuckCompensation_ = enable;
+}
+
+ThreadPool::HibernateStat ThreadPool::getHibernateStat()
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    return hibernateStat_;
+}
+
+int ThreadPool::getCurThreadSize() const
+{
+    return curThreadSize_;
+}
+
+std::unique_lock<std::mutex> ThreadPool::lockQueue()
+{
+    std::unique_lock<std::mutex> lock(taskQueMtx_, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        lock.lock();
+        lockContended_++;
+    }
+    lockAcquired_++;
+    return lock;
+}
+
+PoolStats ThreadPool::stats()
+{
+    std::unique_lock<std::mutex> lock = lockQueue();
+    PoolStats stats;
+    stats.queueDepth = static_cast<int>(taskQue_.size());
+    stats.tenants = taskQue_.stats();
+    stats.maxQueueDepth = maxQueueDepth_;
+    stats.threadSize = curThreadSize_;
+    stats.idleThreadSize = idleThreadSize_;
+    stats.rejected = counters_.rejected.load(std::memory_order_relaxed);
+    stats.blocked = blockedSize_;
+    stats.callerRuns = counters_.callerRuns.load(std::memory_order_relaxed);
+    stats.dropped = droppedSize_;
+    stats.shed = shedSize_;
+    stats.overloaded = overloaded_;
+    stats.steals = counters_.steals.load(std::memory_order_relaxed);
+    stats.lockAcquired = lockAcquired_;
+    stats.lockContended = lockContended_;
+    stats.stuckTasks = stuckTaskSize_;
+    stats.cpuCount = cpuCount_;
+    stats.total.add(retiredStats_);
+    stats.total.add(stolenStats_);
+    //threads_只在持锁时增删，线程对象不会在读的过程中析构
+    for (auto& item : threads_)
+    {
+        WorkerStatsSnapshot worker;
+        worker.threadId = item.first;
+        worker.add(item.second->stats());
+        stats.total.add(worker);
+        stats.workers.emplace_back(std::move(worker));
+    }
+    return stats;
 }
 
 //给线程池添加任务 生产者
@@ -75,7 +589,7 @@ void ThreadPool::setInitThreadSize(int size)
 *void ThreadPool::submitTask(std::shared_ptr<Task> sp)
 {
     //获得锁
-    std::unique_lock<std::mutex> lock(taskQueMtx_);
+    std::unique_lock<std::mutex> lock = lockQueue();
 
     //线程的通信 等待任务队列有空余
     //用户提交任务，最长不能阻塞超过1s, 否则判断提交任务失败，返回
@@ -117,10 +631,34 @@ void ThreadPool::setInitThreadSize(int size)
 }
 */
 //##############Result返回值##############
+Result ThreadPool::submitTask(std::shared_ptr<Task> sp, CancellationToken token)
+{
+    sp->token_ = std::move(token);
+    return submitTask(std::move(sp));
+}
+
 Result ThreadPool::submitTask(std::shared_ptr<Task> sp)
 {
+    //按提交类别限速，在拿锁之前做，等令牌的时候不占着taskQueMtx_
+    if (sp->submitClass_ != nullptr)
+    {
+        SubmitClass* submitClass = sp->submitClass_;
+        if (sp->waitForToken_)
+        {
+            if (submitClass->bucket_.acquire().count() > 0)
+            {
+                submitClass->waited_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        else if (!submitClass->bucket_.tryAcquire())
+        {
+            submitClass->rejected_.fetch_add(1, std::memory_order_relaxed);
+            return Result(sp, SubmitStatus::RATE_LIMITED);
+        }
+        submitClass->admitted_.fetch_add(1, std::memory_order_relaxed);
+    }
     //获得锁
-    std::unique_lock<std::mutex> lock(taskQueMtx_);
+    std::unique_lock<std::mutex> lock = lockQueue();
     //线程的通信 等待任务队列有空余
     //用户提交任务，最长不能阻塞超过1s, 否则判断提交任务失败，返回
     //方法1：
@@ -141,40 +679,123 @@ Result ThreadPool::submitTask(std::shared_ptr<Task> sp)
     //*方法3：wait_for, 等待1s
     //!先判断taskQue_.size() < taskQueMaxThreshold_,如果返回true,执行下面的语句，
     //如果返回false: 阻塞等待1s, 如果超过1s则return, 如果未超过1s阻塞停止，就继续执行下面的语句
-    if (!notFull_.wait_for(lock, std::chrono::seconds(1), 
-            [&]()->bool{
-                return taskQue_.size() < taskQueMaxThreshold_;
-            }))
+    //现在等多久由rejectPolicy_决定，只有BLOCK和BLOCK_TIMEOUT会等
+    //等待期间线程池被shutdown也要醒来
+    auto notFull = [&]()->bool {
+        return isShutdown_ || taskQue_.size() < static_cast<size_t>(taskQueMaxThreshold_);
+    };
+    if (!notFull())
     {
-        //表示notFull等待1s, 条件依然没有满足
-        std::cerr << "task queue is full, submit task fail." << std::endl;
+        switch (rejectPolicy_)
+        {
+        case RejectPolicy::BLOCK:
+            blockedSize_++;
+            notFull_.wait(lock, notFull);
+            break;
+        case RejectPolicy::BLOCK_TIMEOUT:
+            blockedSize_++;
+            notFull_.wait_for(lock, rejectTimeout_, notFull);
+            break;
+        case RejectPolicy::CALLER_RUNS:
+            //不持锁执行，其他提交者和工作线程不受影响
+            lock.unlock();
+            counters_.callerRuns.fetch_add(1, std::memory_order_relaxed);
+            if (sp->token_.stop_requested())
+            {
+                sp->cancel();
+            }
+            else
+            {
+                sp->exec();
+            }
+            return Result(sp, SubmitStatus::RAN_IN_CALLER);
+        case RejectPolicy::DROP_OLDEST:
+            //队头是等得最久的任务，已经最可能没用了
+            if (!taskQue_.empty())
+            {
+                std::shared_ptr<Task> oldest = taskQue_.popOldest();
+                taskSize_--;
+                if (oldest->claim())
+                {
+                    droppedSize_++;
+                    oldest->cancel();
+                }
+                else
+                {
+                    stealsPending_++;
+                }
+            }
+            break;
+        case RejectPolicy::FAIL_FAST:
+            break;
+        }
+    }
+    //拒绝的结果由SubmitStatus和计数器报告，不在持锁时打印
+    if (isShutdown_)
+    {
+        counters_.rejected.fetch_add(1, std::memory_order_relaxed);
+        return Result(sp, SubmitStatus::SHUT_DOWN);
+    }
+    //排队延迟已经超标，低优先级任务不再进队列；队列是空的就不算，进来马上就能执行
+    if (overloaded_ && !taskQue_.empty() && sp->priority_ == TaskPriority::LOW)
+    {
+        shedSize_++;
+        return Result(sp, SubmitStatus::SHED);
+    }
+    if (!notFull())
+    {
+        //BLOCK_TIMEOUT等到超时，或者FAIL_FAST，条件依然没有满足
+        counters_.rejected.fetch_add(1, std::memory_order_relaxed);
         //?选择哪一个？
         // return task->getResult();//不可以用这个，为什么？
-        return Result(sp, false);//false代表无效任务返回值
+        return Result(sp, SubmitStatus::QUEUE_FULL);//代表无效任务返回值
+    }
+    //线程池在休眠，一个线程都没有，先把它唤醒
+    if (hibernating_)
+    {
+        wakeUp();
     }
     //如果有空余 把任务放入任务队列中
-    taskQue_.emplace(sp);
+    sp->enqueueTime_ = std::chrono::steady_clock::now();
+    sp->pool_ = workerStartHook_ ? nullptr : this;
+    taskQue_.push(sp, sp->tenant_);
     taskSize_++; //将task的数量++
+    maxQueueDepth_ = std::max(maxQueueDepth_, static_cast<int>(taskQue_.size()));
+    TP_TRACE_AT(TraceEventType::ENQUEUE, sp->enqueueTime_, sp.get(), sp->name_);
     //因为新放了任务，任务队列肯定不空了， 在notEmpty上通知消费者 ，分配线程执行任务
-    notEmpty_.notify_all();
+    //只放了一个任务，唤醒一个线程就够了，notify_all会把所有空闲线程都叫起来抢锁
+    notEmpty_.notify_one();
+    //从预算借线程的线程池一个线程都没有(min为0，或者都被拒绝了)，让管理线程去借
+    if (budget_ != nullptr && curThreadSize_ == 0)
+    {
+        supervisorReschedule_ = true;
+        supervisorCond_.notify_one();
+    }
 
     //?需要根据任务数量和空闲线程数量，判断是否需要创建新的线程
     //cached模式 任务处理比较紧急 场景：小而快的任务，需要根据任务数量和空闲线程数量，判断是否为空
     //返回任务的Result对象
+    //自适应模式下线程数由管理线程按吞吐量调整
+    //创建线程(clone)要几十微秒，不能在持锁提交任务时做：有备用线程就唤醒一个，否则交给管理线程去创建
     if (poolMode_ == PoolMode::MODE_CACHED 
-        && taskSize_ > idleThreadSize_
-        && curThreadSize_ < threadSizeThreshold_)
+        && !adaptive_
+        && taskSize_ > idleThreadSize_ + growThreadSize_
+        && curThreadSize_ + growThreadSize_ < threadSizeThreshold_)
     {
-        std::cout <<  ">>> create new thread" << std::endl;
-        //创建新线程
-		auto ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this,  std::placeholders::_1));
-        int threadId = ptr->getId();
-        threads_.emplace(threadId, std::move(ptr));
-        //启动线程
-        threads_[threadId]->start();
-        //修改线程个数相关变量++
-        curThreadSize_++;
-        idleThreadSize_++;
+        if (spareThreadSize_ > 0 && acquireThreads(1) == 1)
+        {
+            spareThreadSize_--;
+            spareActivateSize_++;
+            curThreadSize_++;
+            idleThreadSize_++;
+            spareCond_.notify_one();
+        }
+        else
+        {
+            growThreadSize_++;
+        }
+        //不管哪种情况都通知管理线程，用掉了备用线程也要补上
+        supervisorCond_.notify_one();
     }
     //返回任务的Result对象
     return Result(sp);
@@ -184,30 +805,502 @@ Result ThreadPool::submitTask(std::shared_ptr<Task> sp)
 //开始线程池
 void ThreadPool::start(int initThreadSize) //CPU默认核心数量
 {   
+    std::unique_lock<std::mutex> lock = lockQueue();
     //设置线程池的运行状态
     isPoolRunning_ = true;
-    //记录初始线程对象
-    initThreadSize_  = initThreadSize;
-    curThreadSize_  = initThreadSize;
-    for (int i = 0; i  < initThreadSize_; i++)
+    poolIdleSince_ = std::chrono::steady_clock::now();
+    if (budget_ != nullptr)
+    {
+        //线程数由预算决定，initThreadSize_在setThreadBudget里已经设好
+        addThreads(lock, initThreadSize_);
+    }
+    else if (autoSize_)
+    {
+        //按容器真正能用的CPU数开线程，而不是宿主机的核数
+        lock.unlock();
+        int cpus = CpuQuota::effectiveCpuCount();//要读文件，不要持锁
+        lock.lock();
+        applyCpuCount(lock, cpus);
+    }
+    else
     {
+        //记录初始线程对象，没给参数就用setInitThreadSize设置的值
+        if (initThreadSize > 0)
+        {
+            initThreadSize_  = initThreadSize;
+            threadSizeThreshold_ = std::max<int>(threadSizeThreshold_, initThreadSize);
+        }
         //创建thread线程对象的时候，把线程对象给thread线程对象
-        //?这个地方是重点，用绑定器把threadFunc绑定在ptr上
-		auto ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
+        //?这个地方是重点，用绑定器把threadFunc绑定在线程对象上
+        addThreads(lock, initThreadSize_);
+    }
+    publishConfig();
+    startSupervisor();
+}
+
+//cached模式的加线程、补充备用线程，配额在运行期间被修改(kubectl set resources / 垂直扩缩容)，
+//自适应模式周期性采样吞吐量，这些都交给管理线程
+//watchdog也由管理线程负责
+void ThreadPool::startSupervisor()
+{
+    if (supervisor_.joinable())
+    {
+        return;
+    }
+    //从预算借线程的线程池，被拒绝的线程要由管理线程重试
+    if (autoSize_ || poolMode_ == PoolMode::MODE_CACHED || hibernateTime_ > 0 || stuckTaskHandler_ || budget_ != nullptr)
+    {
+        supervisor_ = std::thread(&ThreadPool::supervisorFunc, this);
+    }
+}
+
+//创建并启动size个线程
+//std::thread的创建(clone)比较慢，启动线程时先把锁放掉，不要让提交任务和取任务的线程都等着
+void ThreadPool::addThreads(std::unique_lock<std::mutex>& lock, int size, bool spare)
+{
+    std::vector<Thread*> created;
+    if (!spare)
+    {
+        //超出预算的部分先不创建，记下来由管理线程等别的线程池还回线程后重试
+        int granted = acquireThreads(size);
+        budgetDeficit_ += size - granted;
+        size = granted;
+    }
+    for (int i = 0; i < size; i++)
+    {
+        auto func = spare ? &ThreadPool::spareThreadFunc : &ThreadPool::threadFunc;
+        auto ptr = std::make_unique<Thread>(std::bind(func, this, std::placeholders::_1));
+        created.push_back(ptr.get());
         int threadId = ptr->getId();
         threads_.emplace(threadId, std::move(ptr));
-        // threads_.emplace_back(std::move(ptr));//对应的new一定会有delete
         //因为unique_ptr是不允许普通的拷贝构造和赋值，所以要用右值
-        //bind的意义是，将ThreadPool函数对象绑定在threadFunc函数上
+        //修改线程个数相关变量++
+        if (spare)
+        {
+            spareThreadSize_++;
+        }
+        else
+        {
+            curThreadSize_++;
+            idleThreadSize_++;
+        }
+    }
+    //线程还没启动，不会把自己从threads_里删掉，放锁以后这些裸指针依然有效
+    lock.unlock();
+    for (Thread* thread : created)
+    {
+        TP_TRACE(TraceEventType::SPAWN, thread->getId());
+        thread->start();
+    }
+    lock.lock();
+}
+
+//备用线程函数
+void ThreadPool::spareThreadFunc(int threadid)
+{
+    {
+        std::unique_lock<std::mutex> lock = lockQueue();
+        spareCond_.wait(lock, [&]()->bool{ return spareActivateSize_ > 0 || !isPoolRunning_ || hibernating_; });
+        if (spareActivateSize_ == 0)
+        {
+            //线程池结束或者休眠，没被用上的备用线程直接退出
+            spareThreadSize_--;
+            releaseThread(threadid);
+            if (hibernating_ && spareThreadSize_ == 0)
+            {
+                supervisorCond_.notify_one();
+            }
+            return;
+        }
+        //submitTask已经把这个线程计入curThreadSize_和idleThreadSize_
+        spareActivateSize_--;
+    }
+    threadFunc(threadid);
+}
+
+//管理线程
+void ThreadPool::supervisorFunc()
+{
+    using Clock = std::chrono::steady_clock;
+    auto lastControl = Clock::now();
+    auto nextQuotaCheck = lastControl + CPU_QUOTA_CHECK_INTERVAL;
+    auto nextControl = lastControl + THREAD_CONTROL_INTERVAL;
+    bool watchdog = static_cast<bool>(stuckTaskHandler_);
+    auto nextWatchdog = lastControl + WATCHDOG_CHECK_INTERVAL;
+    auto nextBudgetRetry = lastControl;
+    //还缺多少线程要向预算申请：fixed模式补到initThreadSize，cached模式只在有任务排队时补被拒绝的那些；
+    //队列里有任务却一个线程都没有(min为0的线程池)时至少要一个，否则这些任务永远没人执行
+    auto budgetWanted = [&]()->int {
+        if (budget_ == nullptr || hibernating_)
+        {
+            return 0;
+        }
+        int wanted = 0;
+        if (poolMode_ == PoolMode::MODE_FIXED)
+        {
+            wanted = static_cast<int>(initThreadSize_) - curThreadSize_;
+        }
+        else if (!taskQue_.empty())
+        {
+            wanted = std::min(budgetDeficit_, threadSizeThreshold_ - curThreadSize_);
+        }
+        if (curThreadSize_ == 0 && !taskQue_.empty())
+        {
+            wanted = std::max(wanted, 1);
+        }
+        return wanted;
+    };
+    auto hasWork = [&]()->bool {
+        return !isPoolRunning_ || supervisorReschedule_ || growThreadSize_ > 0 || spareThreadSize_ < reserveThreadSize_;
+    };
+    std::unique_lock<std::mutex> lock = lockQueue();
+    while (isPoolRunning_)
+    {
+        //运行期间可能切换了模式
+        bool control = adaptive_ && poolMode_ == PoolMode::MODE_CACHED;
+        //只在最近的一个期限醒来
+        auto deadline = Clock::time_point::max();
+        if (autoSize_)
+        {
+            deadline = std::min(deadline, nextQuotaCheck);
+        }
+        if (control)
+        {
+            deadline = std::min(deadline, nextControl);
+        }
+        if (watchdog)
+        {
+            deadline = std::min(deadline, nextWatchdog);
+        }
+        if (budgetWanted() > 0)
+        {
+            deadline = std::min(deadline, nextBudgetRetry);
+        }
+        //空闲最久的线程的回收期限
+        if (!idleThreads_.empty()
+            && curThreadSize_ - static_cast<int>(retiringThreads_.size()) > static_cast<int>(initThreadSize_))
+        {
+            deadline = std::min(deadline, idleThreads_.front().since + std::chrono::seconds(threadMaxIdleTime_));
+        }
+        //整个线程池空闲了，休眠的期限
+        bool poolIdle = hibernateTime_ > 0 && taskQue_.empty() && idleThreadSize_ == curThreadSize_ && growThreadSize_ == 0;
+        if (poolIdle)
+        {
+            deadline = std::min(deadline, poolIdleSince_ + std::chrono::seconds(hibernateTime_));
+        }
+        if (deadline != Clock::time_point::max())
+        {
+            supervisorCond_.wait_until(lock, deadline, hasWork);
+        }
+        else
+        {
+            supervisorCond_.wait(lock, hasWork);
+        }
+        if (!isPoolRunning_)
+        {
+            break;
+        }
+        supervisorReschedule_ = false;
+        //回收期间退出的线程
+        joinExitedThreads(lock);
+        //submitTask请求的线程
+        if (growThreadSize_ > 0)
+        {
+            int size = growThreadSize_;
+            growThreadSize_ = 0;
+            addThreads(lock, size);
+        }
+        //补充备用线程
+        if (spareThreadSize_ < reserveThreadSize_)
+        {
+            addThreads(lock, reserveThreadSize_ - spareThreadSize_, true);
+        }
+        auto now = Clock::now();
+        //预算不够没创建成的线程，别的线程池的线程回收以后就能借到了
+        if (budget_ != nullptr && now >= nextBudgetRetry)
+        {
+            int wanted = budgetWanted();
+            budgetDeficit_ = 0;
+            if (wanted > 0)
+            {
+                addThreads(lock, wanted);
+            }
+            nextBudgetRetry = now + BUDGET_RETRY_INTERVAL;
+        }
+        if (autoSize_ && now >= nextQuotaCheck)
+        {
+            lock.unlock();
+            int cpus = CpuQuota::effectiveCpuCount();
+            lock.lock();
+            if (cpus != cpuCount_)
+            {
+                //管理线程也不往stdout打日志，变化记在Trace里，当前值在PoolStats::cpuCount
+                TP_TRACE(TraceEventType::QUOTA, cpus);
+                applyCpuCount(lock, cpus);
+            }
+            nextQuotaCheck = now + CPU_QUOTA_CHECK_INTERVAL;
+        }
+        if (control && now >= nextControl)
+        {
+            adjustThreadSize(lock, std::chrono::duration<double>(now - lastControl).count());
+            lastControl = now;
+            nextControl = now + THREAD_CONTROL_INTERVAL;
+        }
+        if (watchdog && now >= nextWatchdog)
+        {
+            checkStuckTasks(lock, now);
+            nextWatchdog = now + WATCHDOG_CHECK_INTERVAL;
+        }
+        reapIdleThreads(now);
+        poolIdle = hibernateTime_ > 0 && taskQue_.empty() && idleThreadSize_ == curThreadSize_ && growThreadSize_ == 0;
+        if (poolIdle && poolIdleSince_ + std::chrono::seconds(hibernateTime_) <= now)
+        {
+            //等所有线程退出并join完，管理线程自己也退出，下一次submitTask再把它启动起来
+            //等的过程中被唤醒了就接着当管理线程
+            if (hibernate(lock))
+            {
+                supervisorExited_ = true;
+                return;
+            }
+        }
+    }
+}
+
+//线程池进入休眠
+bool ThreadPool::hibernate(std::unique_lock<std::mutex>& lock)
+{
+    hibernating_ = true;
+    hibernateStat_.hibernateCount++;
+    //所有线程都空闲，全部领取退出名额(init线程也不例外)，备用线程看到hibernating_也会退出
+    retireThreadSize_ = curThreadSize_;
+    notEmpty_.notify_all();
+    spareCond_.notify_all();
+    //退出的线程也要join掉，不然休眠的线程池还留着一堆没回收的线程
+    supervisorCond_.wait(lock, [&]()->bool {
+        return !hibernating_ || !isPoolRunning_ || (curThreadSize_ == 0 && spareThreadSize_ == 0);
+    });
+    joinExitedThreads(lock);
+    return hibernating_ && isPoolRunning_;
+}
+
+//从休眠中唤醒
+void ThreadPool::wakeUp()
+{
+    hibernating_ = false;
+    hibernateStat_.wakeCount++;
+    wakeTime_ = std::chrono::steady_clock::now();
+    //刚休眠、还没来得及退出的线程留下来继续用，不够的让管理线程创建
+    retireThreadSize_ = 0;
+    growThreadSize_ = std::max(0, static_cast<int>(initThreadSize_) - curThreadSize_);
+    poolIdleSince_ = wakeTime_;
+    //管理线程还在hibernate()里等线程退出，叫醒它接着干活就行
+    if (!supervisorExited_)
+    {
+        supervisorCond_.notify_one();
+        return;
     }
+    //上一个管理线程已经退出(持锁把supervisorExited_置位后就return了)，join不会等锁
+    if (supervisor_.joinable())
+    {
+        supervisor_.join();
+    }
+    supervisorExited_ = false;
+    supervisor_ = std::thread(&ThreadPool::supervisorFunc, this);
+}
 
-    //启动所有线程
-    //    std::vector<Thread*>  threads_;//线程列表
-    for (int i = 0; i < initThreadSize_; i++)
-    { 
-        threads_[i]->start();//启动所有线程(而非线程),需要执行一个线程函数
-        idleThreadSize_++; //记录初始空闲线程的数量
+//watchdog：找出执行时间超过自己超时的任务
+void ThreadPool::checkStuckTasks(std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point now)
+{
+    int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+    std::vector<StuckTask> stuck;
+    auto check = [&](Thread::RunningTask& running, int threadId)
+    {
+        int64_t start = running.start.load(std::memory_order_acquire);
+        if (start == 0 || start == running.reported)
+        {
+            return;
+        }
+        int64_t timeout = running.timeout.load(std::memory_order_relaxed);
+        const char* name = running.name.load(std::memory_order_relaxed);
+        //读的过程中换了任务，下一轮再看
+        if (timeout == 0 || nowNs - start < timeout || running.start.load(std::memory_order_acquire) != start)
+        {
+            return;
+        }
+        running.reported = start;
+        stuck.push_back(StuckTask{name, threadId, std::chrono::nanoseconds(nowNs - start),
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::nanoseconds(timeout))});
+    };
+    for (auto& item : threads_)
+    {
+        check(item.second->runningTask(), item.first);
+    }
+    //被卡住的工作线程不会回来取任务，cached模式补上同样数量的线程；Result::get()的调用者线程不占工作线程，不用补
+    int stuckWorkers = static_cast<int>(stuck.size());
+    for (Thread::RunningTask& running : stolenTasks_)
+    {
+        check(running, -1);
+    }
+    if (stuck.empty())
+    {
+        return;
+    }
+    stuckTaskSize_ += stuck.size();
+    if (stuckCompensation_ && poolMode_ == PoolMode::MODE_CACHED)
+    {
+        int size = std::min(stuckWorkers, threadSizeThreshold_ - curThreadSize_);
+        if (size > 0)
+        {
+            addThreads(lock, size);
+        }
+    }
+    lock.unlock();
+    for (const StuckTask& task : stuck)
+    {
+        stuckTaskHandler_(task);
+    }
+    lock.lock();
+}
+
+//根据吞吐量调整线程数
+void ThreadPool::adjustThreadSize(std::unique_lock<std::mutex>& lock, double seconds)
+{
+    int completed = completedTaskSize_.exchange(0);
+    int cur = curThreadSize_ - retireThreadSize_;//已经领了退出名额的线程不算
+    int target = cur;
+    if (taskSize_ == 0)
+    {
+        //没有积压，吞吐量只取决于提交速度，加减线程都看不出效果，空闲线程交给空闲回收处理
+        hillClimbing_.reset();
+        return;
+    }
+    if (completed == 0)
+    {
+        //有积压但一个任务都没完成，线程全被阻塞住了(IO/锁)，直接补一个线程防止饿死
+        target = std::min(cur + 1, threadSizeThreshold_);
+    }
+    else
+    {
+        hillClimbing_.setBounds(initThreadSize_, threadSizeThreshold_);
+        target = hillClimbing_.update(cur, completed / seconds);
+    }
+    if (target > cur)
+    {
+        //先把还没退出的线程留下来，不够再创建
+        retireThreadSize_ = std::max(0, curThreadSize_ - target);
+        if (target > curThreadSize_)
+        {
+            addThreads(lock, target - curThreadSize_);
+        }
+    }
+    else if (target < cur)
+    {
+        retireThreadSize_ = curThreadSize_ - target;
+        notEmpty_.notify_all();
+    }
+}
+
+//按可用CPU数调整线程数
+void ThreadPool::applyCpuCount(std::unique_lock<std::mutex>& lock, int cpus)
+{
+    cpuCount_ = cpus;
+    threadSizeThreshold_ = std::min(THREAD_MAX_THRESHOLD, cpus * AUTO_THREAD_FACTOR);
+    //CPU很多时上限被THREAD_MAX_THRESHOLD截断，初始线程数也不能超过上限
+    initThreadSize_ = std::min(cpus, threadSizeThreshold_);
+    publishConfig();
+    resizeThreads(lock);
+}
+
+void ThreadPool::resizeThreads(std::unique_lock<std::mutex>& lock)
+{
+    //fixed模式线程数就是initThreadSize_；cached模式保证不少于initThreadSize_，不多于上限
+    int target = initThreadSize_;
+    if (poolMode_ == PoolMode::MODE_CACHED)
+    {
+        target = std::min(std::max<int>(curThreadSize_, initThreadSize_), threadSizeThreshold_);
+    }
+    retireThreadSize_ = 0;
+    if (curThreadSize_ < target)
+    {
+        addThreads(lock, target - curThreadSize_);
+    }
+    if (curThreadSize_ > target)
+    {
+        //正在执行任务的线程不能打断，让空闲线程(包括执行完任务后变空闲的线程)自己退出
+        retireThreadSize_ = curThreadSize_ - target;
+        notEmpty_.notify_all();
+    }
+}
+
+//回收空闲超时的线程
+void ThreadPool::reapIdleThreads(std::chrono::steady_clock::time_point now)
+{
+    auto timeout = std::chrono::seconds(threadMaxIdleTime_);
+    bool reaped = false;
+    //idleThreads_按变空闲的先后排序，队头就是空闲最久的线程
+    while (!idleThreads_.empty()
+        && curThreadSize_ - static_cast<int>(retiringThreads_.size()) > static_cast<int>(initThreadSize_) //一定要保证线程数量 >= initsize
+        && idleThreads_.front().since + timeout <= now)
+    {
+        idleThreads_.front().retire = true;
+        //挪到retiringThreads_，线程持有的迭代器依然有效
+        retiringThreads_.splice(retiringThreads_.end(), idleThreads_, idleThreads_.begin());
+        reaped = true;
+    }
+    if (reaped)
+    {
+        notEmpty_.notify_all();
+    }
+}
+
+//线程退出时从线程池中删除自己
+void ThreadPool::removeThread(int threadid)
+{
+    //线程的统计合并到已退出线程的合计里，stats()里的总数不会因为线程回收而变少
+    retiredStats_.add(threads_[threadid]->stats());
+    releaseThread(threadid);//删掉线程后，空闲线程和线程池数量--
+    if (budget_ != nullptr)
+    {
+        budget_->release(budgetMember_, 1);
+    }
+    curThreadSize_--;
+    idleThreadSize_--;
+    TP_TRACE(TraceEventType::EXIT, threadid);
+    //休眠时管理线程等着最后一个线程退出
+    if (hibernating_ && curThreadSize_ == 0)
+    {
+        supervisorCond_.notify_one();
+    }
+    //被唤醒去取任务的线程如果正好退出了，把通知传给别的线程
+    if (taskQue_.size() > 0)
+    {
+        notEmpty_.notify_one();
+    }
+}
+
+void ThreadPool::releaseThread(int threadid)
+{
+    auto it = threads_.find(threadid);
+    exitedThreads_.emplace_back(std::move(it->second));
+    threads_.erase(it);
+}
+
+void ThreadPool::joinExitedThreads(std::unique_lock<std::mutex>& lock)
+{
+    if (exitedThreads_.empty())
+    {
+        return;
+    }
+    std::vector<std::unique_ptr<Thread>> exited;
+    exited.swap(exitedThreads_);
+    lock.unlock();
+    //这些线程已经放掉锁准备返回了，join很快
+    for (auto& thread : exited)
+    {
+        thread->join();
     }
+    exited.clear();
+    lock.lock();
 }
 
 //定义线程函数(线程池的所有任务从线程池消费任务)
@@ -217,16 +1310,56 @@ void ThreadPool::threadFunc(int threadid) //线程函数返回， 相应的线
     // std::cout << std::endl;
     // std::cout << "end threadFunc" << std::this_thread::get_id() << std::endl;
     //如果在相同的线程，打印的id是一样的，不一样的线程是不一样的
-    auto lastTime = std::chrono::high_resolution_clock::now();
     //线程不断循环 
     //!如果不加unlock或者局部作用区域，则在一个线程未执行完之前，一直占用这把锁，没有其他线程对task队列进行操作，降低线程池效率
     //所有任务必须执行完成，线程池才可以回收所有线程资源，所以不能用    while(isPoolRunning_) 
+    //线程对象在本线程退出(removeThread)之前一直在threads_里，统计可以直接写，不用每次查表
+    Thread* self = nullptr;
+    {
+        std::unique_lock<std::mutex> lock = lockQueue();
+        self = threads_[threadid].get();
+    }
+    WorkerStats* stats = &self->stats();
+    Thread::RunningTask& running = self->runningTask();
+    //线程函数有好几个return，用析构函数保证退出时调用onWorkerStop；
+    //scope比循环里的unique_lock先构造，return时锁先析构，调用hook时不持锁
+    struct WorkerScope
+    {
+        WorkerScope(WorkerContext& context, const std::function<void(WorkerContext&)>& stop)
+            : context_(context)
+            , stop_(stop)
+        {
+            currentWorkerContext = &context;
+        }
+        ~WorkerScope()
+        {
+            if (stop_)
+            {
+                stop_(context_);
+            }
+            //资源在这个线程里释放
+            context_.reset();
+            currentWorkerContext = nullptr;
+        }
+        WorkerContext& context_;
+        const std::function<void(WorkerContext&)>& stop_;
+    };
+    WorkerScope scope(self->context(), workerStopHook_);
+    if (workerStartHook_)
+    {
+        workerStartHook_(self->context());
+    }
+    //上一个任务的租户和pop时预扣的配额
+    int tenant = FairTaskQueue::DEFAULT_TENANT;
+    int64_t charged = 0;
+    int64_t runTime = 0;
+    bool chargePending = false;
     for (;;)
     {
 		//方法1：unlock
 		/* 
 		//先获得锁
-		std::unique_lock<std::mutex> lock(taskQueMtx_);
+		std::unique_lock<std::mutex> lock = lockQueue();
 
 		//等待notEmpty条件
 		//* true通过，false阻塞
@@ -243,68 +1376,161 @@ void ThreadPool::threadFunc(int threadid) //线程函数返回， 相应的线
 
 		//方法2：加上局部作用区域 
 		std::shared_ptr<Task> task;
+		std::chrono::steady_clock::time_point startTime;
 		{
 			//先获得锁
-			std::unique_lock<std::mutex> lock(taskQueMtx_);
-			std::cout << "tid:" << std::this_thread::get_id() << "尝试获取任务..." << std::endl;
+			std::unique_lock<std::mutex> lock = lockQueue();
+			//上一个任务的实际执行时间记到它的租户上，趁这次拿锁顺便做，不用执行完再单独拿一次锁
+			if (chargePending)
+			{
+				taskQue_.charge(tenant, charged, runTime);
+				chargePending = false;
+			}
+			//线程数缩容时刚执行完任务的线程也领退出名额，不用等队列排空，负载高的时候调小线程数也能马上生效
+			if (retireThreadSize_ > 0)
+			{
+				retireThreadSize_--;
+				removeThread(threadid);
+				return;
+			}
+			//不要在持锁的时候用std::cout打日志：所有线程会排队抢stdout的锁，每行还要flush，需要看过程就打开Trace
 			//cached模式下，有可能已经创建了很多线程，但是空闲时间超过60s,应该把多余的线程回收掉？
 			//结束回收掉(超过initThreadSize数量的线程要回收)
-			//当前时间 -  上一次线程执行时间  > 60s
+			//不再每个线程每秒醒来检查一次空闲时间：空闲线程按变空闲的先后排进idleThreads_，
+			//由管理线程在最早的期限到了时挑空闲最久的线程退出，空闲线程一直睡到有任务或者被回收
+			std::list<IdleThread>::iterator idleIt;
+			bool listed = false;
+			bool idleChecked = false;
 			while (taskQue_.size() ==  0)
 			{
+                //最后一个忙碌的线程也空闲了，记下时间，交给管理线程判断要不要休眠
+                if (!idleChecked)
+                {
+                    idleChecked = true;
+                    if (hibernateTime_ > 0 && idleThreadSize_ == curThreadSize_)
+                    {
+                        poolIdleSince_ = std::chrono::steady_clock::now();
+                        supervisorReschedule_ = true;
+                        supervisorCond_.notify_one();
+                    }
+                }
                 //线程池结束,回收线程 资源
                 if (!isPoolRunning_ )
                 {
                     //线程函数结束，删除线程
-                    threads_.erase(threadid);//删掉线程后，空闲线程和线程池数量--
-                    std::cout << ">>> threadid...." << std::this_thread::get_id() << "exit" << std::endl;
-                    exitCond_.notify_all();//通知等待在exitCond_.wait(lock,  [&]()->bool{return threads_.size() == 0;});进入阻塞状态
+                    if (listed)
+                    {
+                        idleThreads_.erase(idleIt);
+                    }
+                    removeThread(threadid);
                     return;//线程函数结束，线程结束
+                }
+                //线程数缩容，空闲线程领取退出名额
+                if (retireThreadSize_ > 0)
+                {
+                    retireThreadSize_--;
+                    if (listed)
+                    {
+                        idleThreads_.erase(idleIt);
+                    }
+                    removeThread(threadid);
+                    return;
                 }
 				if (poolMode_ == PoolMode::MODE_CACHED)
 				{
-					// !任务队列里面有任务不等待，无任务才等待，所以为taskQue_.size() == 0
-                    if (std::cv_status::timeout == 
-                            notEmpty_.wait_for(lock, std::chrono::seconds(1)))
+                    if (!listed)
                     {
-                        auto now = std::chrono::high_resolution_clock::now();
-                        auto dur = std::chrono::duration_cast<std::chrono::seconds>(now - lastTime);
-                        //dur.count()表示的是Second
-                        if (dur.count() >= THREAD_MAX_IDLE_TIME
-                            && curThreadSize_ > initThreadSize_) //不能一直回收线程，一定要保证线程数量 > initsize
+                        idleIt = idleThreads_.insert(idleThreads_.end(), IdleThread{std::chrono::steady_clock::now(), false});
+                        listed = true;
+                        //只有第一个变空闲的线程会改变最早的回收期限
+                        if (idleThreads_.size() == 1 && curThreadSize_ > static_cast<int>(initThreadSize_))
                         {
-                            //开始回收当前线程
-                            threads_.erase(threadid);//删掉线程后，空闲线程和线程池数量--
-                            curThreadSize_--;
-                            idleThreadSize_--;
-                            std::cout << ">>> threadid...." << std::this_thread::get_id() << "exit" << std::endl;
-                            return;
+                            supervisorReschedule_ = true;
+                            supervisorCond_.notify_one();
                         }
+                    }
+					// !任务队列里面有任务不等待，无任务才等待，所以为taskQue_.size() == 0
+                    WorkerStats::increment(stats->parks);
+                    TP_TRACE(TraceEventType::PARK, threadid);
+                    notEmpty_.wait(lock);
+                    TP_TRACE(TraceEventType::WAKE, threadid);
+                    if (idleIt->retire)
+                    {
+                        //管理线程选中了这个线程回收，它已经把记录挪到了retiringThreads_
+                        retiringThreads_.erase(idleIt);
+                        removeThread(threadid);
+                        return;
                     }
 				}
 				else //若不是cached状态
 				{
+                    //运行期间从cached切成了fixed，已经排进idleThreads_的记录要拿掉
+                    if (listed)
+                    {
+                        if (idleIt->retire)
+                        {
+                            retiringThreads_.erase(idleIt);
+                            removeThread(threadid);
+                            return;
+                        }
+                        idleThreads_.erase(idleIt);
+                        listed = false;
+                    }
 					//等待notEmpty条件。如果没有超时，则执行notEmpty_.wait(lock)
 					//* true通过，false阻塞
+					WorkerStats::increment(stats->parks);
+					TP_TRACE(TraceEventType::PARK, threadid);
 					notEmpty_.wait(lock);
+					TP_TRACE(TraceEventType::WAKE, threadid);
 				}
-				// //线程池结束,回收线程 资源
-				// if (!isPoolRunning_ )
-				// {
-				// 	threads_.erase(threadid);//删掉线程后，空闲线程和线程池数量--
-				// 	std::cout << ">>> threadid...." << std::this_thread::get_id() << "exit" << std::endl;
-				// 	exitCond_.notify_all();//通知在exitCond_.wait(lock,  [&]()->bool{return threads_.size() == 0;});进入阻塞状态，判断threads.size()是否为0
-				// 	return;//结束线程和函数，就是结束
-				// }
 			}
+            if (listed)
+            {
+                idleThreads_.erase(idleIt);
+            }
             //如果任务队列非空，取出一个任务并减小任务队列大小，然后通知其他等待在 notEmpty_ 上的线程（消费者线程）有任务可以执行。
             //同时通知等待在 notFull_ 上的线程（生产者线程）可以继续提交任务。
 			idleThreadSize_--; //线程起来了，要去任务队列取任务，所以线程数量--
-			std::cout << "tid:" << std::this_thread::get_id() << "获取任务成功..." << std::endl;
+			startTime = std::chrono::steady_clock::now();
+			//唤醒后的第一个任务开始执行，记录冷启动时间
+			if (wakeTime_ != std::chrono::steady_clock::time_point())
+			{
+				auto coldStart = startTime - wakeTime_;
+				hibernateStat_.lastColdStart = coldStart;
+				hibernateStat_.totalColdStart += coldStart;
+				wakeTime_ = std::chrono::steady_clock::time_point();
+			}
 			//从任务队列中取一个任务
-			task = taskQue_.front();
-			taskQue_.pop();
+			//多个租户时按DRR挑租户，不一定是最早进队列的任务
+			task = taskQue_.pop(tenant, charged);
 			taskSize_--;
+			TP_TRACE_AT(TraceEventType::DEQUEUE, startTime, task.get(), nullptr);
+			//提交者在Result::get()里领走了、还没来得及拿锁把这一项拿掉，直接扔掉；taskSize_这里已经减过，它回来时不用再减
+			if (!task->claim())
+			{
+				stealsPending_++;
+				task = nullptr;
+			}
+			//提交者已经不要结果了，不执行，直接让Result返回
+			else if (task->token_.stop_requested())
+			{
+				task->cancel();
+				WorkerStats::increment(stats->tasksCancelled);
+				task = nullptr;
+			}
+			//过载时低优先级任务不执行，把时间让给后面的任务，尽快把队列排空
+			else if (updateAdmission(startTime - task->enqueueTime_, startTime)
+				&& task->priority_ == TaskPriority::LOW)
+			{
+				task->cancel();
+				shedSize_++;
+				task = nullptr;
+			}
+			//没有执行的任务不占租户的配额
+			if (task == nullptr)
+			{
+				taskQue_.refund(tenant, charged);
+			}
 
 			//如果依然有剩余任务，继续通知其他线程(消费者)执行任务。有wait就有notify!
 			//notEmpty_->消费者, notFull_->生产者
@@ -320,11 +1546,12 @@ void ThreadPool::threadFunc(int threadid) //线程函数返回， 相应的线
 		{
 			//把任务的返回值setVal方法给到Result
 			//*如果要增加更多任务在run上，价格函数套run, 发生多态
-			task->exec();
+			runTime = runTask(task.get(), *stats, false, running, startTime);
+			chargePending = true;
             //task->run();//基类指针指向哪个派生对象，就会调用哪个派生对象对应的同名重载方法
 		}
+		completedTaskSize_++;
 		idleThreadSize_++; //线程任务执行完后，线程数量++
-		lastTime = std::chrono::high_resolution_clock::now(); //更新线程执行完的时间
 		/*
 		这个地方有一个问题：
 		1. thread从task队列中拿到一把锁，等待任务执行完后再释放mutex
@@ -333,12 +1560,130 @@ void ThreadPool::threadFunc(int threadid) //线程函数返回， 相应的线
 		*/
     }//如果不加unlock, unique_lock在此处释放mutex
 }
+
+int64_t ThreadPool::runTask(Task* task, WorkerStats& stats, bool concurrent, Thread::RunningTask& running,
+    std::chrono::steady_clock::time_point startTime)
+{
+    auto waitTime = std::chrono::duration_cast<std::chrono::nanoseconds>(startTime - task->enqueueTime_).count();
+    concurrent ? stats.waitTime.recordConcurrent(waitTime) : stats.waitTime.record(waitTime);
+    TP_TRACE_AT(TraceEventType::START, startTime, task, task->name_);
+    //告诉watchdog正在执行什么，start最后写，watchdog读到start就能看到同一个任务的timeout和name
+    if (task->timeout_.count() > 0)
+    {
+        running.timeout.store(std::chrono::duration_cast<std::chrono::nanoseconds>(task->timeout_).count(), std::memory_order_relaxed);
+        running.name.store(task->name_, std::memory_order_relaxed);
+        running.start.store(std::chrono::duration_cast<std::chrono::nanoseconds>(startTime.time_since_epoch()).count(), std::memory_order_release);
+    }
+    task->exec();
+    if (task->exception_ != nullptr)
+    {
+        concurrent ? (void)stats.tasksFailed.fetch_add(1, std::memory_order_relaxed) : WorkerStats::increment(stats.tasksFailed);
+    }
+    if (task->timeout_.count() > 0)
+    {
+        running.start.store(0, std::memory_order_release);
+    }
+    auto finishTime = std::chrono::steady_clock::now();
+    TP_TRACE_AT(TraceEventType::FINISH, finishTime, task, nullptr);
+    int64_t runTime = std::chrono::duration_cast<std::chrono::nanoseconds>(finishTime - startTime).count();
+    concurrent ? stats.runTime.recordConcurrent(runTime) : stats.runTime.record(runTime);
+    concurrent ? (void)stats.tasksExecuted.fetch_add(1, std::memory_order_relaxed) : WorkerStats::increment(stats.tasksExecuted);
+    return runTime;
+}
+
+void ThreadPool::runStolen(const std::shared_ptr<Task>& task)
+{
+    counters_.steals.fetch_add(1, std::memory_order_relaxed);
+    int tenant = task->tenant_;
+    std::list<Thread::RunningTask>::iterator running;
+    std::chrono::steady_clock::time_point startTime;
+    {
+        std::unique_lock<std::mutex> lock = lockQueue();
+        startTime = std::chrono::steady_clock::now();
+        //和工作线程取走一样：腾出队列的位置，taskSize_减一；已经被别人取出来扔掉的话它们减过了
+        if (taskQue_.remove(task.get(), tenant))
+        {
+            taskSize_--;
+            notFull_.notify_all();
+        }
+        else
+        {
+            stealsPending_--;
+        }
+        //排队时间照样算进准入控制；调用者在等它的结果，过载时也不丢弃
+        updateAdmission(startTime - task->enqueueTime_, startTime);
+        running = stolenTasks_.emplace(stolenTasks_.end());
+    }
+    int64_t runTime = -1;
+    if (task->token_.stop_requested())
+    {
+        task->cancel();
+        stolenStats_.tasksCancelled.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        //调用者线程没有工作线程的上下文，给它一个空的，执行完换回原来的(调用者可能是别的线程池的工作线程)
+        WorkerContext context(-1);
+        WorkerContext* saved = currentWorkerContext;
+        currentWorkerContext = &context;
+        runTime = runTask(task.get(), stolenStats_, true, *running, startTime);
+        currentWorkerContext = saved;
+    }
+    std::unique_lock<std::mutex> lock = lockQueue();
+    if (runTime >= 0)
+    {
+        //没有预扣过，按实际执行时间全额记到租户上
+        taskQue_.charge(tenant, 0, runTime);
+        completedTaskSize_++;
+    }
+    stolenTasks_.erase(running);
+    //shutdown可能在等最后一个get()，通知完放锁以后线程池就可能析构，不能再访问成员
+    if (isShutdown_)
+    {
+        notFull_.notify_all();
+    }
+}
 //=============================线程池================================
 
 
 
 //=============================线程================================
-int Thread::generateId_ = 0;
+WorkerStats::WorkerStats()
+    : tasksExecuted(0)
+    , parks(0)
+    , tasksCancelled(0)
+    , tasksFailed(0)
+{}
+
+WorkerStatsSnapshot::WorkerStatsSnapshot()
+    : threadId(-1)
+    , tasksExecuted(0)
+    , parks(0)
+    , tasksCancelled(0)
+    , tasksFailed(0)
+{}
+
+void WorkerStatsSnapshot::add(const WorkerStats& stats)
+{
+    tasksExecuted += stats.tasksExecuted.load(std::memory_order_relaxed);
+    parks += stats.parks.load(std::memory_order_relaxed);
+    tasksCancelled += stats.tasksCancelled.load(std::memory_order_relaxed);
+    tasksFailed += stats.tasksFailed.load(std::memory_order_relaxed);
+    waitTime.add(stats.waitTime);
+    runTime.add(stats.runTime);
+}
+
+void WorkerStatsSnapshot::add(const WorkerStatsSnapshot& other)
+{
+    tasksExecuted += other.tasksExecuted;
+    parks += other.parks;
+    tasksCancelled += other.tasksCancelled;
+    tasksFailed += other.tasksFailed;
+    waitTime.add(other.waitTime);
+    runTime.add(other.runTime);
+}
+
+std::atomic_int Thread::generateId_(0);
 //判断线程池运行的状态判断
 bool ThreadPool::checkRunningState() const
 {
@@ -348,11 +1693,14 @@ bool ThreadPool::checkRunningState() const
 Thread::Thread(ThreadFunc func)
     : func_(func)
     , threadId_(generateId_++)//每次创建1个线程，都让id++
+    , context_(threadId_)
 {} 
 
 //线程析构 
 Thread::~Thread()
-{}
+{
+    join();
+}
 
 
 //启动线程(注意，启动线程和线程池不一样)
@@ -360,8 +1708,16 @@ void Thread::start()
 {
     //创建一个线程来执行一个线程函数
     //要加上ref(func)
-    std::thread t(func_, threadId_);//C++11来说，线程对象t和线程函数func_
-    t.detach();//设置分离线程， func_和t分离， t.detach和t.join功能差不多
+    //不再detach：线程池关闭时直接join每个线程，不用在条件变量上等线程一个个把自己删掉
+    thread_ = std::thread(func_, threadId_);
+}
+
+void Thread::join()
+{
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
 }
 
 int Thread::getId() const
@@ -373,48 +1729,82 @@ int Thread::getId() const
 
 
 //=============================Task================================
-Task::Task()
-    : result_(nullptr)
-{}
-
 void Task::exec()
 {
-    if (result_  != nullptr)
+    //异常不能从这里漏出去：工作线程会因此退出，任务的Result也永远等不到post
+    //try在不抛异常时没有额外开销
+    try
     {
-        result_->setVal(run());//发生多态调用，方便用户重写run方法
+        any_ = run();//发生多态调用，方便用户重写run方法
     }
+    catch (...)
+    {
+        exception_ = std::current_exception();
+    }
+    sem_.post();//已经获取任务的返回值，增加信号量资源
 }
 
-void Task::setResult(Result* res)
+void Task::cancel()
 {
-    result_ = res;
+    cancelled_ = true;
+    sem_.post();
 }
 
 
 //############Result方法实现##########
-Result::Result(std::shared_ptr<Task> task, bool isValid )
-    : isValid_(isValid)
-    , task_(task)
+Result::Result(std::shared_ptr<Task> task, SubmitStatus status)
+    : task_(task)
+    , isValid_(status == SubmitStatus::ACCEPTED || status == SubmitStatus::RAN_IN_CALLER)
+    , status_(status)
+{}
+
+bool Result::isCancelled() const
 {
-    task_->setResult(this);
+    return isValid_ && task_ != nullptr && task_->cancelled_;
 }
 
-Any Result::get() //用户执行的
+//get()返回之后任务已经结束，这些成员不会再变
+ResultState Result::getState() const
 {
+    if (task_ == nullptr)
+    {
+        return ResultState::INVALID;
+    }
     if (!isValid_)
     {
-        return "";
+        return ResultState::REJECTED;
+    }
+    if (task_->cancelled_)
+    {
+        return ResultState::CANCELLED;
     }
-    sem_.wait(); //task任务如果没有执行完，会阻塞用户线程,任务执行完了，post一下，sem_有资源，继续执行
-    //std::any_为左值 threadid.
-    return  std::move(any_);//由于Any成员变量为unique_ptr，他是没有左值的，所以要返回右值
+    if (task_->exception_ != nullptr)
+    {
+        return ResultState::FAILED;
+    }
+    return ResultState::OK;
 }
-void Result::setVal(Any any)
+
+Any Result::get() //用户执行的
 {
-    //存储task的返回值
-    this->any_ = std::move(any);
-    sem_.post();//已经获取任务的返回值，增加信号量资源
+    if (!isValid_ || task_ == nullptr)
+    {
+        return Any();
+    }
+    //还没有工作线程取走，自己执行，不用睡下去等工作线程执行完再被叫醒
+    //领到了说明任务还没被别人取走，线程池的shutdown要等runStolen结束，线程池还没析构
+    if (task_->pool_ != nullptr && task_->claim())
+    {
+        task_->pool_->runStolen(task_);
+    }
+    task_->sem_.wait(); //task任务如果没有执行完，会阻塞用户线程,任务执行完了，post一下，sem_有资源，继续执行
+    if (task_->cancelled_)
+    {
+        return Any();
+    }
+    if (task_->exception_ != nullptr)
+    {
+        std::rethrow_exception(task_->exception_);
+    }
+    return  std::move(task_->any_);//由于Any成员变量为unique_ptr，他是没有左值的，所以要返回右值
 }
-
-
-
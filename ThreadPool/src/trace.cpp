@@ -0,0 +1,369 @@
+#include "trace.h"
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+std::atomic_bool Trace::enabled_(false);
+
+namespace
+{
+const size_t TRACE_DEFAULT_BUFFER_SIZE = 16384;//每个线程默认16K个事件，512KB
+const uint32_t TRACE_FILE_VERSION = 2;
+
+//环形缓冲区的一个槽，用relaxed原子变量存，dump线程读的时候不算数据竞争
+struct Slot
+{
+    std::atomic<uint64_t> timestamp;
+    std::atomic<uint64_t> arg;
+    std::atomic<uint64_t> typeAndThread; //高32位type，低32位tid
+    std::atomic<uint64_t> extra;
+};
+
+//单写者环形缓冲区：只有所属线程写，head只增不减
+struct TraceBuffer
+{
+    TraceBuffer(size_t size)
+        : slots(new Slot[size])
+        , mask(size - 1)
+        , head(0)
+        , threadId(0)
+        , inUse(true)
+    {}
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    std::atomic<uint64_t> head; //下一个要写的位置
+    uint32_t threadId;
+    bool inUse; //所属线程还活着，受registryMtx保护
+};
+
+std::mutex registryMtx;
+std::vector<std::unique_ptr<TraceBuffer>> registry; //线程退出后缓冲区留着(事件还要dump)，给新线程复用
+size_t bufferSize = TRACE_DEFAULT_BUFFER_SIZE;
+
+//线程退出时把缓冲区还回去
+struct LocalBuffer
+{
+    TraceBuffer* buffer = nullptr;
+    ~LocalBuffer()
+    {
+        if (buffer != nullptr)
+        {
+            std::lock_guard<std::mutex> lock(registryMtx);
+            buffer->inUse = false;
+        }
+    }
+};
+thread_local LocalBuffer localBuffer;
+
+//第一次记录事件时分配缓冲区，优先复用已退出线程的缓冲区，cached模式线程反复创建退出时内存不会一直涨
+TraceBuffer* acquireBuffer()
+{
+    std::lock_guard<std::mutex> lock(registryMtx);
+    TraceBuffer* buffer = nullptr;
+    for (auto& b : registry)
+    {
+        if (!b->inUse)
+        {
+            buffer = b.get();
+            break;
+        }
+    }
+    if (buffer == nullptr)
+    {
+        registry.emplace_back(std::make_unique<TraceBuffer>(bufferSize));
+        buffer = registry.back().get();
+    }
+    buffer->inUse = true;
+    buffer->threadId = static_cast<uint32_t>(::syscall(SYS_gettid));
+    return buffer;
+}
+
+uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//写一个槽
+void write(uint64_t timestamp, TraceEventType type, uint64_t arg, uint64_t extra)
+{
+    TraceBuffer* buffer = localBuffer.buffer;
+    if (buffer == nullptr)
+    {
+        buffer = localBuffer.buffer = acquireBuffer();
+    }
+    uint64_t h = buffer->head.load(std::memory_order_relaxed);
+    Slot& slot = buffer->slots[h & buffer->mask];
+    slot.timestamp.store(timestamp, std::memory_order_relaxed);
+    slot.arg.store(arg, std::memory_order_relaxed);
+    slot.typeAndThread.store((static_cast<uint64_t>(type) << 32) | buffer->threadId, std::memory_order_relaxed);
+    slot.extra.store(extra, std::memory_order_relaxed);
+    //release：读到新head的dump线程一定能看到槽里的内容
+    buffer->head.store(h + 1, std::memory_order_release);
+}
+
+//json字符串转义
+void writeJsonString(FILE* fp, const std::string& str)
+{
+    std::fputc('"', fp);
+    for (unsigned char c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            std::fprintf(fp, "\\%c", c);
+        }
+        else if (c < 0x20)
+        {
+            std::fprintf(fp, "\\u%04x", c);
+        }
+        else
+        {
+            std::fputc(c, fp);
+        }
+    }
+    std::fputc('"', fp);
+}
+
+//collect()出来的事件里用到的任务名
+TraceNameTable nameTable(const std::vector<TraceEvent>& events)
+{
+    TraceNameTable names;
+    for (const TraceEvent& e : events)
+    {
+        if (e.extra != 0 && names.find(e.extra) == names.end())
+        {
+            names.emplace(e.extra, reinterpret_cast<const char*>(static_cast<uintptr_t>(e.extra)));
+        }
+    }
+    return names;
+}
+}
+
+void Trace::enable(bool on)
+{
+    enabled_.store(on, std::memory_order_relaxed);
+}
+
+void Trace::setBufferSize(size_t events)
+{
+    size_t size = 1;
+    while (size < events)
+    {
+        size <<= 1;
+    }
+    std::lock_guard<std::mutex> lock(registryMtx);
+    bufferSize = size;
+}
+
+void Trace::record(TraceEventType type, uint64_t arg)
+{
+    write(nowNs(), type, arg, 0);
+}
+
+void Trace::record(TraceEventType type, std::chrono::steady_clock::time_point time, const void* arg, const char* name)
+{
+    write(std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count(), type,
+        static_cast<uint64_t>(reinterpret_cast<uintptr_t>(arg)), static_cast<uint64_t>(reinterpret_cast<uintptr_t>(name)));
+}
+
+std::vector<TraceEvent> Trace::collect()
+{
+    std::vector<TraceEvent> events;
+    std::lock_guard<std::mutex> lock(registryMtx);
+    for (auto& buffer : registry)
+    {
+        size_t capacity = buffer->mask + 1;
+        uint64_t end = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = end > capacity ? end - capacity : 0;
+        size_t first = events.size();
+        for (uint64_t i = begin; i < end; i++)
+        {
+            const Slot& slot = buffer->slots[i & buffer->mask];
+            uint64_t typeAndThread = slot.typeAndThread.load(std::memory_order_relaxed);
+            TraceEvent event;
+            event.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+            event.arg = slot.arg.load(std::memory_order_relaxed);
+            event.threadId = static_cast<uint32_t>(typeAndThread);
+            event.type = static_cast<uint32_t>(typeAndThread >> 32);
+            event.extra = slot.extra.load(std::memory_order_relaxed);
+            events.push_back(event);
+        }
+        //复制期间所属线程还在写，被覆盖掉的旧槽读到的可能是半新半旧的内容，丢掉
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = buffer->head.load(std::memory_order_relaxed);
+        if (after > begin + capacity)
+        {
+            size_t overwritten = std::min<uint64_t>(after - capacity - begin, end - begin);
+            events.erase(events.begin() + first, events.begin() + first + overwritten);
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+        return a.timestamp < b.timestamp;
+    });
+    return events;
+}
+
+size_t Trace::dump(const char* path)
+{
+    std::vector<TraceEvent> events = collect();
+    FILE* fp = std::fopen(path, "wb");
+    if (fp == nullptr)
+    {
+        return 0;
+    }
+    TraceFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "TPTRACE", 7);
+    header.version = TRACE_FILE_VERSION;
+    header.eventSize = sizeof(TraceEvent);
+    header.eventCount = events.size();
+    bool ok = std::fwrite(&header, sizeof(header), 1, fp) == 1
+        && (events.empty() || std::fwrite(events.data(), sizeof(TraceEvent), events.size(), fp) == events.size());
+    //任务名在进程里是指针，写到文件里要带上字符串
+    TraceNameTable names = nameTable(events);
+    uint64_t nameCount = names.size();
+    ok = ok && std::fwrite(&nameCount, sizeof(nameCount), 1, fp) == 1;
+    for (auto& item : names)
+    {
+        uint32_t length = static_cast<uint32_t>(item.second.size());
+        ok = ok && std::fwrite(&item.first, sizeof(item.first), 1, fp) == 1
+            && std::fwrite(&length, sizeof(length), 1, fp) == 1
+            && std::fwrite(item.second.data(), 1, length, fp) == length;
+    }
+    std::fclose(fp);
+    return ok ? events.size() : 0;
+}
+
+size_t Trace::dumpChrome(const char* path)
+{
+    std::vector<TraceEvent> events = collect();
+    FILE* fp = std::fopen(path, "w");
+    if (fp == nullptr)
+    {
+        return 0;
+    }
+    writeChrome(fp, events, nameTable(events));
+    bool ok = std::ferror(fp) == 0;
+    std::fclose(fp);
+    return ok ? events.size() : 0;
+}
+
+void Trace::writeChrome(FILE* fp, const std::vector<TraceEvent>& events, const TraceNameTable& names)
+{
+    //工作线程挂起/唤醒/退出事件的arg是线程池里的线程id，用来给轨道起名字
+    std::unordered_map<uint32_t, long long> workerIds;
+    for (const TraceEvent& e : events)
+    {
+        auto type = static_cast<TraceEventType>(e.type);
+        if (type == TraceEventType::PARK || type == TraceEventType::WAKE || type == TraceEventType::EXIT)
+        {
+            workerIds[e.threadId] = static_cast<long long>(e.arg);
+        }
+        else if (type == TraceEventType::START)
+        {
+            workerIds.emplace(e.threadId, -1);
+        }
+    }
+    auto taskName = [&](uint64_t extra) -> std::string {
+        auto it = names.find(extra);
+        return it != names.end() ? it->second : std::string("task");
+    };
+
+    std::fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    std::fprintf(fp, "{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"ThreadPool\"}}");
+    std::unordered_map<uint32_t, bool> namedThreads;
+    for (const TraceEvent& e : events)
+    {
+        if (!namedThreads.emplace(e.threadId, true).second)
+        {
+            continue;
+        }
+        auto it = workerIds.find(e.threadId);
+        std::string name;
+        if (it == workerIds.end())
+        {
+            name = "thread " + std::to_string(e.threadId);
+        }
+        else if (it->second >= 0)
+        {
+            name = "worker " + std::to_string(it->second);
+        }
+        else
+        {
+            name = "worker (tid " + std::to_string(e.threadId) + ")";
+        }
+        std::fprintf(fp, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", e.threadId);
+        writeJsonString(fp, name);
+        std::fprintf(fp, "}}");
+    }
+
+    uint64_t base = events.empty() ? 0 : events[0].timestamp;
+    //任务地址 -> flow id：任务入队以后在开始执行之前不会析构，地址只会在FINISH之后被别的任务复用，按时间顺序配对不会配错
+    std::unordered_map<uint64_t, uint64_t> flows;
+    uint64_t nextFlow = 1;
+    //每个线程当前打开的slice层数，开头被覆盖掉的START对应的FINISH不输出
+    std::unordered_map<uint32_t, int> depth;
+    for (const TraceEvent& e : events)
+    {
+        double ts = (e.timestamp - base) / 1000.0;
+        switch (static_cast<TraceEventType>(e.type))
+        {
+        case TraceEventType::ENQUEUE:
+            //flow的起点要落在一个slice里，给提交画一个0长度的slice
+            flows[e.arg] = nextFlow;
+            std::fprintf(fp, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":0,\"name\":\"submit\",\"args\":{\"task\":", e.threadId, ts);
+            writeJsonString(fp, taskName(e.extra));
+            std::fprintf(fp, "}}");
+            std::fprintf(fp, ",\n{\"ph\":\"s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"id\":%llu,\"cat\":\"task\",\"name\":\"queue\"}",
+                e.threadId, ts, static_cast<unsigned long long>(nextFlow));
+            nextFlow++;
+            break;
+        case TraceEventType::START:
+        {
+            auto it = flows.find(e.arg);
+            if (it != flows.end())
+            {
+                std::fprintf(fp, ",\n{\"ph\":\"f\",\"bp\":\"e\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"id\":%llu,\"cat\":\"task\",\"name\":\"queue\"}",
+                    e.threadId, ts, static_cast<unsigned long long>(it->second));
+                flows.erase(it);
+            }
+            std::fprintf(fp, ",\n{\"ph\":\"B\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":", e.threadId, ts);
+            writeJsonString(fp, taskName(e.extra));
+            std::fprintf(fp, "}");
+            depth[e.threadId]++;
+            break;
+        }
+        case TraceEventType::FINISH:
+            if (depth[e.threadId] > 0)
+            {
+                depth[e.threadId]--;
+                std::fprintf(fp, ",\n{\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}", e.threadId, ts);
+            }
+            break;
+        case TraceEventType::PARK:
+        case TraceEventType::WAKE:
+        case TraceEventType::SPAWN:
+        case TraceEventType::EXIT:
+        case TraceEventType::QUOTA:
+            std::fprintf(fp, ",\n{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":\"%s\",\"args\":{\"thread\":%lld}}",
+                e.threadId, ts, eventName(e.type), static_cast<long long>(e.arg));
+            break;
+        default:
+            //DEQUEUE和START是同一个时间戳，不单独画
+            break;
+        }
+    }
+    std::fprintf(fp, "\n]}\n");
+}
+
+const char* Trace::eventName(uint32_t type)
+{
+    static const char* names[] = {"ENQUEUE", "DEQUEUE", "START", "FINISH", "PARK", "WAKE", "SPAWN", "EXIT", "QUOTA"};
+    return type < sizeof(names) / sizeof(names[0]) ? names[type] : "UNKNOWN";
+}
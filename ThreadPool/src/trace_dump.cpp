@@ -0,0 +1,76 @@
+#include "trace.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+/*
+离线查看Trace::dump()写出的二进制文件
+用法：trace_dump [-c] threadpool.trace
+每行：相对第一个事件的时间(us) 线程tid 事件 参数 [任务名]
+-c：输出Chrome Trace Event格式的json，重定向到文件后用chrome://tracing或ui.perfetto.dev打开
+*/
+int main(int argc, char** argv)
+{
+    bool chrome = argc > 2 && std::strcmp(argv[1], "-c") == 0;
+    const char* path = chrome ? argv[2] : argv[1];
+    if (argc < 2 || (argc > 2 && !chrome))
+    {
+        std::fprintf(stderr, "usage: %s [-c] <trace file>\n", argv[0]);
+        return 1;
+    }
+    FILE* fp = std::fopen(path, "rb");
+    if (fp == nullptr)
+    {
+        std::perror(path);
+        return 1;
+    }
+    TraceFileHeader header;
+    if (std::fread(&header, sizeof(header), 1, fp) != 1
+        || std::memcmp(header.magic, "TPTRACE", 7) != 0
+        || header.eventSize != sizeof(TraceEvent))
+    {
+        std::fprintf(stderr, "%s: not a threadpool trace file\n", path);
+        std::fclose(fp);
+        return 1;
+    }
+    std::vector<TraceEvent> events(header.eventCount);
+    size_t n = events.empty() ? 0 : std::fread(events.data(), sizeof(TraceEvent), events.size(), fp);
+    events.resize(n);
+    //version 1的文件没有任务名表
+    TraceNameTable names;
+    uint64_t nameCount = 0;
+    if (header.version >= 2 && std::fread(&nameCount, sizeof(nameCount), 1, fp) == 1)
+    {
+        for (uint64_t i = 0; i < nameCount; i++)
+        {
+            uint64_t key = 0;
+            uint32_t length = 0;
+            if (std::fread(&key, sizeof(key), 1, fp) != 1 || std::fread(&length, sizeof(length), 1, fp) != 1)
+            {
+                break;
+            }
+            std::string name(length, '\0');
+            if (length > 0 && std::fread(&name[0], 1, length, fp) != length)
+            {
+                break;
+            }
+            names.emplace(key, std::move(name));
+        }
+    }
+    std::fclose(fp);
+    if (chrome)
+    {
+        Trace::writeChrome(stdout, events, names);
+        return 0;
+    }
+    uint64_t base = n > 0 ? events[0].timestamp : 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        const TraceEvent& e = events[i];
+        auto it = names.find(e.extra);
+        std::printf("%12.3f %8u %-8s %#llx %s\n", (e.timestamp - base) / 1000.0, e.threadId,
+            Trace::eventName(e.type), static_cast<unsigned long long>(e.arg),
+            it != names.end() ? it->second.c_str() : "");
+    }
+    return 0;
+}
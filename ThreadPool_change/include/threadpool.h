@@ -12,6 +12,8 @@
 #include <unordered_map>
 #include <future>
 #include <functional>
+#include <stdexcept>
+#include <chrono>
 #include <semaphore.h>
 
 const int TASK_MAX_THRESHOLD = INT32_MAX;//最大任务数量2147483647
@@ -56,6 +58,33 @@ enum class PoolMode //加上class后，枚举类型的作用域被限制在类
     MODE_FIXED, //固定大小线程池
     MODE_CACHED, //动态大小线程池
 };
+//任务队列满了之后submitTask怎么办
+enum class RejectPolicy
+{
+    BLOCK, //一直等到队列有空位
+    BLOCK_TIMEOUT, //最多等setRejectPolicy给的timeout，超时拒绝，默认就是这种(等1s)
+    FAIL_FAST, //不等，直接拒绝
+    CALLER_RUNS, //在提交线程里直接执行这个任务，提交者自己被拖慢，天然限流
+    DROP_OLDEST, //丢掉队头最老的任务(它的future.get()抛std::future_error(broken_promise))，新任务入队
+};
+
+//任务没能提交，future.get()抛这个异常。以前返回默认构造的RType()，和真正的返回值分不出来
+class TaskRejected : public std::runtime_error
+{
+public:
+    explicit TaskRejected(const char* what)
+        : std::runtime_error(what)
+    {}
+};
+
+//队列满时各种处理方式发生的次数
+struct RejectStats
+{
+    uint64_t rejected; //被拒绝的任务数(FAIL_FAST，或者BLOCK_TIMEOUT等超时)
+    uint64_t blocked; //提交时因为队列满等待过的次数
+    uint64_t callerRuns; //在提交线程里执行的任务数
+    uint64_t dropped; //被新任务挤出队列的任务数
+};
 /*
 
 提交任务
@@ -76,6 +105,9 @@ public:
         , taskQueMaxThreshold_  (TASK_MAX_THRESHOLD)//不要在代码中出现除了0/1的数字，数字要用变量代替
         , poolMode_(PoolMode::MODE_FIXED) 
         , isPoolRunning_(false) 
+        , rejectPolicy_(RejectPolicy::BLOCK_TIMEOUT)
+        , rejectTimeout_(std::chrono::seconds(1))
+        , rejectStats_{0, 0, 0, 0}
         {}
 
     //线程池的析构,在C++工程中，有资源的分配，就有资源的析构
@@ -107,7 +139,21 @@ public:
         {
             return;
         }
-        threadSizeThreshold_ = threshold;
+        taskQueMaxThreshold_ = threshold;
+    }
+
+    //任务队列满时的处理方式，timeout只对BLOCK_TIMEOUT有效，运行期间也可以修改
+    void setRejectPolicy(RejectPolicy policy, std::chrono::milliseconds timeout = std::chrono::seconds(1))
+    {
+        std::unique_lock<std::mutex> lock(taskQueMtx_);
+        rejectPolicy_ = policy;
+        rejectTimeout_ = timeout;
+    }
+
+    RejectStats getRejectStats()
+    {
+        std::unique_lock<std::mutex> lock(taskQueMtx_);
+        return rejectStats_;
     }
 
     void setInitThreadSize(int size)
@@ -154,18 +200,47 @@ public:
         
         std::unique_lock<std::mutex> lock(taskQueMtx_);
 
-        //等待在条件变量上
-        if (!notFull_.wait_for(lock, std::chrono::seconds(1), 
-        [&]()->bool{
-            return taskQue_.size() < taskQueMaxThreshold_;
-        }))
+        //队列满了按rejectPolicy_处理
+        auto notFull = [&]()->bool{
+            return taskQue_.size() < static_cast<size_t>(taskQueMaxThreshold_);
+        };
+        if (!notFull())
         {
-            std::cerr << "task queue is full, submit task fail." << std::endl;
-            auto task = std::make_shared<std::packaged_task<RType()>>(
-                []()->RType{ return RType(); }); //返回RType类型
-
-            (*task)(); //执行task对象
-            return task->get_future();
+            switch (rejectPolicy_)
+            {
+            case RejectPolicy::BLOCK:
+                rejectStats_.blocked++;
+                notFull_.wait(lock, notFull);
+                break;
+            case RejectPolicy::BLOCK_TIMEOUT:
+                rejectStats_.blocked++;
+                notFull_.wait_for(lock, rejectTimeout_, notFull);
+                break;
+            case RejectPolicy::CALLER_RUNS:
+                rejectStats_.callerRuns++;
+                lock.unlock();
+                (*task)();
+                return result;
+            case RejectPolicy::DROP_OLDEST:
+                //队头的packaged_task析构，它的future得到broken_promise
+                if (!taskQue_.empty())
+                {
+                    taskQue_.pop();
+                    taskSize_--;
+                    rejectStats_.dropped++;
+                }
+                break;
+            case RejectPolicy::FAIL_FAST:
+                break;
+            }
+        }
+        if (!notFull())
+        {
+            rejectStats_.rejected++;
+            //不再返回RType()：调用者get()时拿到异常，知道任务根本没执行
+            std::promise<RType> rejected;
+            rejected.set_exception(std::make_exception_ptr(TaskRejected("task queue is full, submit task fail.")));
+            return rejected.get_future();
         }
 
         //如果有空余 把任务放入任务队列中
@@ -187,7 +262,6 @@ public:
             && taskSize_ > idleThreadSize_
             && curThreadSize_ < threadSizeThreshold_)
         {
-            std::cout <<  ">>> create new thread" << std::endl;
             //创建新线程
             auto ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this,  std::placeholders::_1));
             int threadId = ptr->getId();
@@ -223,11 +297,11 @@ public:
         }
 
         //启动所有线程
-        //    std::vector<Thread*>  threads_;//线程列表
-        for (int i = 0; i < initThreadSize_; i++)
+        //线程id是全局递增的，第二个线程池的id不从0开始，不能用threads_[i]
+        for (auto& item : threads_)
         { 
-            threads_[i]->start();//启动所有线程(而非线程),需要执行一个线程函数
             idleThreadSize_++; //记录初始空闲线程的数量
+            item.second->start();//启动所有线程(而非线程),需要执行一个线程函数
         }
     }
 
@@ -249,8 +323,7 @@ public:
             {
                 //先获得锁
                 std::unique_lock<std::mutex> lock(taskQueMtx_);
-                // std::cout << "tid:" << std::this_thread::get_id() << "尝试获取任务..." << std::endl;
-                std::cout << "love dabao============" << std::this_thread::get_id() << "==========love dabao" << std::endl;
+                //不要在持锁的时候每个任务打一次日志：所有线程排队抢stdout的锁，每行还要flush
 
                 //cached模式下，有可能已经创建了很多线程，但是空闲时间超过60s,应该把多余的线程回收掉？
                 //结束回收掉(超过initThreadSize数量的线程要回收)
@@ -262,7 +335,6 @@ public:
                     {
                         //线程函数结束，删除线程
                         threads_.erase(threadid);//删掉线程后，空闲线程和线程池数量--
-                        std::cout << ">>> threadid...." << std::this_thread::get_id() << "exit" << std::endl;
                         exitCond_.notify_all();//通知等待在exitCond_.wait(lock,  [&]()->bool{return threads_.size() == 0;});进入阻塞状态
                         return;//线程函数结束，线程结束
                     }
@@ -282,7 +354,6 @@ public:
                                 threads_.erase(threadid);//删掉线程后，空闲线程和线程池数量--
                                 curThreadSize_--;
                                 idleThreadSize_--;
-                                std::cout << ">>> threadid...." << std::this_thread::get_id() << "exit" << std::endl;
                                 return;
                             }
                         }
@@ -298,7 +369,6 @@ public:
                 //如果任务队列非空，取出一个任务并减小任务队列大小，然后通知其他等待在 notEmpty_ 上的线程（消费者线程）有任务可以执行。
                 //同时通知等待在 notFull_ 上的线程（生产者线程）可以继续提交任务。
                 idleThreadSize_--; //线程起来了，要去任务队列取任务，所以线程数量--
-                std::cout << "tid:" << std::this_thread::get_id() << "获取任务成功..." << std::endl;
                 //从任务队列中取一个任务
                 task = taskQue_.front();
                 taskQue_.pop();
@@ -369,6 +439,10 @@ private:
     //线程池状态
     PoolMode  poolMode_;
     std::atomic_bool isPoolRunning_;//当前线程池的启动状态
+    //队列满时的处理，持有taskQueMtx_时访问
+    RejectPolicy rejectPolicy_;
+    std::chrono::milliseconds rejectTimeout_;
+    RejectStats rejectStats_;
 };
 
 